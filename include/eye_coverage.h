@@ -0,0 +1,182 @@
+// アンチエイリアスした四角い目の描画
+// 目の位置を1/SUBPIXEL_STEPSピクセル単位で扱い、角のブロックのカバレッジ（覆う割合）を
+// サブピクセルの位相ごとに起動時に事前計算しておく。
+// 描画は内側を塗りつぶし、まっすぐな辺は位相から決まる一定の濃さの線、
+// 角はマスクを引いて描くだけなので、ピクセルごとの幾何計算は行わない。
+// 背景は黒の前提で、濃さは目の色を暗くした色で表す（読み戻してのブレンドはしない）。
+#pragma once
+
+#include <M5Unified.h>
+#include "render_target.h"
+#include "eye_state.h"
+
+constexpr int COVERAGE_SAMPLES = 4;                                // カバレッジ計算の1ピクセルあたりの縦横のサンプル数
+constexpr int COVERAGE_FULL = COVERAGE_SAMPLES * COVERAGE_SAMPLES; // 完全に覆われたピクセルのカバレッジ
+
+template <typename Layout>
+struct EyeCoverage
+{
+  static constexpr int WIDTH = Layout::SQUARE_EYE_WIDTH;
+  static constexpr int HEIGHT = Layout::SQUARE_EYE_HEIGHT;
+  static constexpr int RADIUS = Layout::SQUARE_EYE_RADIUS;
+  static constexpr int BLOCK = RADIUS + 1; // 角のブロックの大きさ（丸みの部分をすべて含む）
+
+  // サンプル座標の単位（1ピクセル = UNIT）
+  // 位相の境界は2 * COVERAGE_SAMPLESの倍数、サンプル点はその間の奇数位置になる
+  static constexpr int UNIT = 2 * COVERAGE_SAMPLES * SUBPIXEL_STEPS;
+
+  static_assert(WIDTH > 2 * BLOCK && HEIGHT > 2 * BLOCK, "eye is too small for its corner radius");
+
+  enum Corner
+  {
+    TOP_LEFT,
+    TOP_RIGHT,
+    BOTTOM_LEFT,
+    BOTTOM_RIGHT,
+    CORNER_COUNT
+  };
+
+  // 角のブロックのカバレッジ [角][Yの位相][Xの位相][行][列]（0〜COVERAGE_FULL）
+  static inline uint8_t corners[CORNER_COUNT][SUBPIXEL_STEPS][SUBPIXEL_STEPS][BLOCK][BLOCK];
+  // カバレッジごとの色
+  static inline uint32_t levelColors[COVERAGE_FULL + 1];
+
+  // 目の左上からの角のブロックの位置（ピクセル）
+  static constexpr int cornerX(int corner)
+  {
+    return (corner == TOP_RIGHT || corner == BOTTOM_RIGHT) ? WIDTH - RADIUS : 0;
+  }
+
+  static constexpr int cornerY(int corner)
+  {
+    return (corner == BOTTOM_LEFT || corner == BOTTOM_RIGHT) ? HEIGHT - RADIUS : 0;
+  }
+
+  // 左上が(originX, originY)の角丸四角形の内側かどうか（サンプル座標）
+  static bool inside(int x, int y, int originX, int originY)
+  {
+    int rx = x - originX;
+    int ry = y - originY;
+    if (rx < 0 || ry < 0 || rx >= WIDTH * UNIT || ry >= HEIGHT * UNIT)
+    {
+      return false;
+    }
+    int r = RADIUS * UNIT;
+    int dx = rx < r ? r - rx : (rx > WIDTH * UNIT - r ? rx - (WIDTH * UNIT - r) : 0);
+    int dy = ry < r ? r - ry : (ry > HEIGHT * UNIT - r ? ry - (HEIGHT * UNIT - r) : 0);
+    return dx * dx + dy * dy <= r * r;
+  }
+
+  // マスクと色の表を作る（起動時に1回）
+  static void begin(uint32_t color)
+  {
+    for (int level = 0; level <= COVERAGE_FULL; level++)
+    {
+      uint32_t r = ((color >> 16) & 0xFF) * level / COVERAGE_FULL;
+      uint32_t g = ((color >> 8) & 0xFF) * level / COVERAGE_FULL;
+      uint32_t b = (color & 0xFF) * level / COVERAGE_FULL;
+      levelColors[level] = (r << 16) | (g << 8) | b;
+    }
+
+    constexpr int PHASE_UNIT = UNIT / SUBPIXEL_STEPS;
+    constexpr int SAMPLE_UNIT = UNIT / COVERAGE_SAMPLES;
+    for (int corner = 0; corner < CORNER_COUNT; corner++)
+    {
+      for (int phaseY = 0; phaseY < SUBPIXEL_STEPS; phaseY++)
+      {
+        for (int phaseX = 0; phaseX < SUBPIXEL_STEPS; phaseX++)
+        {
+          for (int row = 0; row < BLOCK; row++)
+          {
+            for (int column = 0; column < BLOCK; column++)
+            {
+              // ブロック内のピクセルを縦横COVERAGE_SAMPLES点ずつ調べる
+              int pixelX = (cornerX(corner) + column) * UNIT;
+              int pixelY = (cornerY(corner) + row) * UNIT;
+              int count = 0;
+              for (int sy = 0; sy < COVERAGE_SAMPLES; sy++)
+              {
+                for (int sx = 0; sx < COVERAGE_SAMPLES; sx++)
+                {
+                  int x = pixelX + sx * SAMPLE_UNIT + SAMPLE_UNIT / 2;
+                  int y = pixelY + sy * SAMPLE_UNIT + SAMPLE_UNIT / 2;
+                  if (inside(x, y, phaseX * PHASE_UNIT, phaseY * PHASE_UNIT))
+                  {
+                    count++;
+                  }
+                }
+              }
+              corners[corner][phaseY][phaseX][row][column] = count;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // 一定の濃さの縦線・横線（カバレッジ0なら何もしない）
+  static void drawLevelV(RenderTarget &target, int x, int y, int h, int level)
+  {
+    if (level > 0)
+    {
+      target.drawFastVLine(x, y, h, levelColors[level]);
+    }
+  }
+
+  static void drawLevelH(RenderTarget &target, int x, int y, int w, int level)
+  {
+    if (level > 0)
+    {
+      target.drawFastHLine(x, y, w, levelColors[level]);
+    }
+  }
+
+  // 左上が(subX, subY)（サブピクセル単位）の目を描画する
+  static void raster(RenderTarget &target, int subX, int subY)
+  {
+    int x = subpixelToPixel(subX);
+    int y = subpixelToPixel(subY);
+    int phaseX = subX & (SUBPIXEL_STEPS - 1);
+    int phaseY = subY & (SUBPIXEL_STEPS - 1);
+    uint32_t full = levelColors[COVERAGE_FULL];
+
+    // まっすぐな辺の端のピクセルのカバレッジ（左・上は位相の分だけ欠け、右・下は位相の分だけはみ出す）
+    int leftLevel = (SUBPIXEL_STEPS - phaseX) * COVERAGE_FULL / SUBPIXEL_STEPS;
+    int rightLevel = phaseX * COVERAGE_FULL / SUBPIXEL_STEPS;
+    int topLevel = (SUBPIXEL_STEPS - phaseY) * COVERAGE_FULL / SUBPIXEL_STEPS;
+    int bottomLevel = phaseY * COVERAGE_FULL / SUBPIXEL_STEPS;
+
+    // 上下の角のブロックにはさまれた帯
+    int bandY = y + BLOCK;
+    int bandH = HEIGHT - RADIUS - BLOCK;
+    drawLevelV(target, x, bandY, bandH, leftLevel);
+    target.fillRect(x + 1, bandY, WIDTH - 1, bandH, full);
+    drawLevelV(target, x + WIDTH, bandY, bandH, rightLevel);
+
+    // 左右の角のブロックにはさまれた上端・下端
+    int spanX = x + BLOCK;
+    int spanW = WIDTH - RADIUS - BLOCK;
+    drawLevelH(target, spanX, y, spanW, topLevel);
+    target.fillRect(spanX, y + 1, spanW, RADIUS, full);
+    target.fillRect(spanX, y + HEIGHT - RADIUS, spanW, RADIUS, full);
+    drawLevelH(target, spanX, y + HEIGHT, spanW, bottomLevel);
+
+    // 角はマスクから描く
+    for (int corner = 0; corner < CORNER_COUNT; corner++)
+    {
+      const uint8_t(&mask)[BLOCK][BLOCK] = corners[corner][phaseY][phaseX];
+      int blockX = x + cornerX(corner);
+      int blockY = y + cornerY(corner);
+      for (int row = 0; row < BLOCK; row++)
+      {
+        for (int column = 0; column < BLOCK; column++)
+        {
+          if (mask[row][column] > 0)
+          {
+            target.drawPixel(blockX + column, blockY + row, levelColors[mask[row][column]]);
+          }
+        }
+      }
+    }
+  }
+};
@@ -0,0 +1,286 @@
+// 目の表情とモーフィング
+// 表情ごとに、目の輪郭を行ごとの範囲（スパン）として起動時に作っておく。
+// 2つの表情の間は、スパンの端点を補間するだけで任意の比率の形が得られる。
+// 輪郭は上端から下端までを同じ行数で持つので、上端・下端を補間すると
+// 形を保ったまま縦に閉じたり開いたりする（瞬きはまぶたが閉じる表現になる）。
+// 描画は1行ごとにスパンの端だけを塗り分けるため、コストは目の高さに比例する。
+#pragma once
+
+#include <M5Unified.h>
+#include <math.h>
+#include "render_target.h"
+#include "eye_coverage.h"
+#include "eye_state.h"
+
+constexpr int MORPH_ONE = 256; // モーフィングの比率の1.0
+
+// 表示する目の形（fromからtoへratioだけ進め、さらに閉じた目へblinkだけ寄せる）
+struct EyeMorph
+{
+  EyeExpression from; // 元の表情
+  EyeExpression to;   // 目標の表情
+  int ratio;          // fromからtoへの比率（0〜MORPH_ONE）
+  int blink;          // 閉じ具合（0〜MORPH_ONE）
+};
+
+template <typename Layout>
+struct EyeOutlines
+{
+  static constexpr int WIDTH = Layout::SQUARE_EYE_WIDTH;
+  static constexpr int HEIGHT = Layout::SQUARE_EYE_HEIGHT;
+  static constexpr int RADIUS = Layout::SQUARE_EYE_RADIUS;
+  static constexpr int ROWS = HEIGHT; // 輪郭の行数（開いた目で1ピクセル1行）
+
+  // 1つの表情の輪郭
+  // 上端から下端までをROWS行に分け、行ごとに塗る範囲と、その中の穴の範囲を持つ。
+  // 座標は目の枠（左目の向き）の左上からのサブピクセル単位。
+  // 穴のない行は穴の左右を中央にそろえておき、補間すると中央から穴が開くようにする。
+  struct Outline
+  {
+    int16_t top;             // 上端
+    int16_t bottom;          // 下端（含まない）
+    int16_t left[ROWS];      // 塗る範囲の左端
+    int16_t right[ROWS];     // 塗る範囲の右端（含まない）
+    int16_t holeLeft[ROWS];  // 穴の左端
+    int16_t holeRight[ROWS]; // 穴の右端（含まない）
+  };
+
+  static inline Outline outlines[EXPRESSION_COUNT];
+
+  // 角の丸みによる左右の削れ（y: 枠の上端からのピクセル）
+  static float roundedInset(float y, float top, float bottom, float topRadius, float bottomRadius)
+  {
+    float d = 0;
+    float r = 0;
+    if (y < top + topRadius)
+    {
+      d = top + topRadius - y;
+      r = topRadius;
+    }
+    else if (y > bottom - bottomRadius)
+    {
+      d = y - (bottom - bottomRadius);
+      r = bottomRadius;
+    }
+    if (r <= 0)
+    {
+      return 0;
+    }
+    return r - sqrtf(max(0.0f, r * r - d * d));
+  }
+
+  // 上向きの弧（半楕円）の半幅（底辺がbottom、高さheight）
+  static float domeHalfWidth(float y, float bottom, float height, float halfWidth)
+  {
+    if (height <= 0 || halfWidth <= 0)
+    {
+      return 0;
+    }
+    float u = (bottom - y) / height;
+    if (u >= 1)
+    {
+      return 0;
+    }
+    return halfWidth * sqrtf(1 - max(0.0f, u) * max(0.0f, u));
+  }
+
+  // 表情の上端と下端（ピクセル）
+  static void extent(int expression, float &top, float &bottom)
+  {
+    top = 0;
+    bottom = HEIGHT;
+    switch (expression)
+    {
+    case EXPRESSION_HALF_CLOSED:
+      top = HEIGHT * 0.4f;
+      break;
+    case EXPRESSION_HAPPY:
+      top = HEIGHT * 0.15f;
+      bottom = HEIGHT * 0.6f;
+      break;
+    case EXPRESSION_ANGRY:
+      top = HEIGHT * 0.15f;
+      break;
+    case EXPRESSION_SLEEPY:
+      top = HEIGHT * 0.65f;
+      break;
+    case EXPRESSION_CLOSED:
+      // 3ピクセルの太さの線
+      top = HEIGHT / 2 - 1.5f;
+      bottom = HEIGHT / 2 + 1.5f;
+      break;
+    default:
+      break;
+    }
+  }
+
+  // 行の塗る範囲と穴の範囲（ピクセル、y: 枠の上端からのピクセル）
+  static void span(int expression, float y, float top, float bottom,
+                   float &left, float &right, float &holeLeft, float &holeRight)
+  {
+    float center = WIDTH / 2.0f;
+    float inset = 0;
+    left = 0;
+    right = WIDTH;
+    holeLeft = holeRight = center;
+
+    switch (expression)
+    {
+    case EXPRESSION_OPEN:
+      inset = roundedInset(y, top, bottom, RADIUS, RADIUS);
+      break;
+    case EXPRESSION_HALF_CLOSED:
+    case EXPRESSION_SLEEPY:
+      // まぶたで上が平らに切られた形
+      inset = roundedInset(y, top, bottom, 0, RADIUS);
+      break;
+    case EXPRESSION_HAPPY:
+    {
+      // 外側の弧から内側の弧をくり抜いた形
+      float thickness = WIDTH / 4.0f;
+      float outer = domeHalfWidth(y, bottom, bottom - top, center);
+      float inner = domeHalfWidth(y, bottom, bottom - top - thickness, center - thickness);
+      left = center - outer;
+      right = center + outer;
+      holeLeft = center - inner;
+      holeRight = center + inner;
+      break;
+    }
+    case EXPRESSION_ANGRY:
+    {
+      // まぶたの線が外側（左）から内側（右）へ下がっていく
+      float drop = HEIGHT * 0.3f;
+      inset = roundedInset(y, top, bottom, 0, RADIUS);
+      right = min((float)WIDTH, (y - top) / drop * WIDTH);
+      break;
+    }
+    case EXPRESSION_SURPRISED:
+    {
+      // 枠の高さいっぱいで、左右に少しずつ大きい楕円（はみ出す分はEyeLayoutのEYE_BULGE_Xで確保してある）
+      // 左右対称にするため、枠で切らずに返す
+      float halfWidth = center + WIDTH / 12.0f;
+      float halfHeight = (bottom - top) / 2;
+      float v = (y - (top + halfHeight)) / halfHeight;
+      float half = halfWidth * sqrtf(max(0.0f, 1 - v * v));
+      left = center - half;
+      right = center + half;
+      return;
+    }
+    case EXPRESSION_CLOSED:
+    default:
+      break;
+    }
+    left += inset;
+    right = min(right, WIDTH - inset);
+  }
+
+  static int16_t toOutline(float pixel)
+  {
+    return (int16_t)lroundf(pixel * SUBPIXEL_STEPS);
+  }
+
+  // すべての表情の輪郭を作る（起動時に1回）
+  static void begin()
+  {
+    for (int expression = 0; expression < EXPRESSION_COUNT; expression++)
+    {
+      Outline &outline = outlines[expression];
+      float top, bottom;
+      extent(expression, top, bottom);
+      outline.top = toOutline(top);
+      outline.bottom = toOutline(bottom);
+      for (int row = 0; row < ROWS; row++)
+      {
+        float y = top + (row + 0.5f) * (bottom - top) / ROWS;
+        float left, right, holeLeft, holeRight;
+        span(expression, y, top, bottom, left, right, holeLeft, holeRight);
+        outline.left[row] = toOutline(left);
+        outline.right[row] = toOutline(right);
+        outline.holeLeft[row] = toOutline(holeLeft);
+        outline.holeRight[row] = toOutline(holeRight);
+      }
+    }
+  }
+
+  // 3つの輪郭の値を補間する
+  static int mix(const EyeMorph &morph, int from, int to, int closed)
+  {
+    int value = from + (to - from) * morph.ratio / MORPH_ONE;
+    return value + (closed - value) * morph.blink / MORPH_ONE;
+  }
+
+  // 1行の範囲を塗る（x0, x1はサブピクセル単位、両端は覆う割合に応じた濃さにする）
+  static void drawSpan(RenderTarget &target, int y, int x0, int x1, int vertical)
+  {
+    if (x1 <= x0 || vertical <= 0)
+    {
+      return;
+    }
+    const uint32_t *colors = EyeCoverage<Layout>::levelColors;
+    int first = subpixelToPixel(x0);
+    int last = subpixelToPixel(x1 - 1);
+    if (first == last)
+    {
+      target.drawPixel(first, y, colors[(x1 - x0) * vertical / SUBPIXEL_STEPS]);
+      return;
+    }
+    target.drawPixel(first, y, colors[(toSubpixel(first + 1) - x0) * vertical / SUBPIXEL_STEPS]);
+    if (last - first > 1)
+    {
+      target.drawFastHLine(first + 1, y, last - first - 1, colors[vertical]);
+    }
+    target.drawPixel(last, y, colors[(x1 - toSubpixel(last)) * vertical / SUBPIXEL_STEPS]);
+  }
+
+  // 左上が(subX, subY)（サブピクセル単位）の目の枠に、モーフィング中の形を描画する
+  // mirrorがtrueなら左右を反転する（右目用）
+  static void raster(RenderTarget &target, int subX, int subY, const EyeMorph &morph, bool mirror)
+  {
+    const Outline &from = outlines[morph.from];
+    const Outline &to = outlines[morph.to];
+    const Outline &closed = outlines[EXPRESSION_CLOSED];
+
+    int top = subY + mix(morph, from.top, to.top, closed.top);
+    int bottom = subY + mix(morph, from.bottom, to.bottom, closed.bottom);
+    if (bottom <= top)
+    {
+      return;
+    }
+    int height = bottom - top;
+    constexpr int MIRROR_X = WIDTH * SUBPIXEL_STEPS;
+
+    for (int y = subpixelToPixel(top); y <= subpixelToPixel(bottom - 1); y++)
+    {
+      // 上端・下端の行は縦に覆う割合で薄くする
+      int rowTop = toSubpixel(y);
+      int covered = min(rowTop + SUBPIXEL_STEPS, bottom) - max(rowTop, top);
+      int vertical = covered * COVERAGE_FULL / SUBPIXEL_STEPS;
+
+      // 行の中心にあたる輪郭の行
+      int row = constrain((rowTop + SUBPIXEL_STEPS / 2 - top) * ROWS / height, 0, ROWS - 1);
+      int left = mix(morph, from.left[row], to.left[row], closed.left[row]);
+      int right = mix(morph, from.right[row], to.right[row], closed.right[row]);
+      int holeLeft = mix(morph, from.holeLeft[row], to.holeLeft[row], closed.holeLeft[row]);
+      int holeRight = mix(morph, from.holeRight[row], to.holeRight[row], closed.holeRight[row]);
+      if (mirror)
+      {
+        int mirroredLeft = MIRROR_X - right;
+        right = MIRROR_X - left;
+        left = mirroredLeft;
+        int mirroredHoleLeft = MIRROR_X - holeRight;
+        holeRight = MIRROR_X - holeLeft;
+        holeLeft = mirroredHoleLeft;
+      }
+
+      if (holeRight > holeLeft)
+      {
+        drawSpan(target, y, subX + left, subX + min(holeLeft, right), vertical);
+        drawSpan(target, y, subX + max(holeRight, left), subX + right, vertical);
+      }
+      else
+      {
+        drawSpan(target, y, subX + left, subX + right, vertical);
+      }
+    }
+  }
+};
@@ -0,0 +1,43 @@
+// 目のセット（1組の目）のインスタンス
+// 目の状態・時刻の取得元・モードを切り替えるタッチの番号を1つにまとめ、いくつでも並べて独立に動かせるようにする。
+// 描画やピンの入出力は持たず、1フレーム分進めるたびに起きたことをビットで返す。
+// 実機（main.cpp）はセットごとに描く領域を割り当て、描き直しが必要なセットをまとめて描く。
+// ホストの耐久試験（tools/soak）は同じコードで複数のセットを仮想クロックで動かし、セットごとの処理時間を計る。
+#pragma once
+
+#include <Arduino.h>
+#include "eye_state.h"
+
+constexpr int EYE_SET_NO_TOUCH = -1; // モードをタッチで切り替えない
+
+typedef uint32_t (*EyeClock)(); // 時刻の取得元（millis()と同じ32bitのミリ秒）
+
+// 1フレームで起きたこと（ビットの組み合わせ）
+enum EyeSetEvent : uint8_t
+{
+  EYE_SET_REDRAW = 1,            // 描き直しが必要
+  EYE_SET_MODE_CHANGED = 2,      // モードが変わった
+  EYE_SET_BRIGHTNESS_CHANGED = 4 // 画面の明るさが変わった
+};
+
+// 目のセット
+struct EyeSet
+{
+  EyeState state;   // 目の状態
+  EyeClock clock;   // 時刻の取得元
+  int touchChannel; // モードを切り替えるタッチの番号（EYE_SET_NO_TOUCH: なし）
+  int maxMove;      // 視線を動かす範囲（ピクセル、中央から上下左右）
+  uint32_t now;     // このフレームの時刻（eyeSetUpdateで取得する）
+};
+
+void eyeSetBegin(EyeSet &set, EyeClock clock, int touchChannel, int maxMove); // 設定して初期状態にする
+void eyeSetReset(EyeSet &set);                                                // 取得元の時刻で初期状態に戻す
+
+// 時刻を取得し、モード・瞬き・視線の移動・表情・スロット・おやすみの状態を1フレーム分進める（起きたことを返す）
+uint8_t eyeSetUpdate(EyeSet &set);
+
+// 表情を切り替える（時刻はeyeSetUpdateで取得したもの、次のeyeSetUpdateから描き直す）
+void eyeSetExpression(EyeSet &set, EyeExpression expression);
+
+// タッチの入力でモードを切り替える（touches: タッチごとの状態、時刻はeyeSetUpdateで取得したもの）
+uint8_t eyeSetTouch(EyeSet &set, const bool *touches);
@@ -0,0 +1,180 @@
+// 目の状態機械（モード・瞬き・視線の移動・表情・ウィンカー）
+// 描画やピンの入出力から切り離し、時刻を引数で受け取って状態だけを進める。
+// 目のセット（eye_set.h）が1組の目ごとに状態を持ち、時刻の取得元の時刻で呼ぶ。
+// 実機ではmain.cppが結果に応じて描画・明るさ・トレースの記録を行い、
+// ホストの耐久試験（tools/soak）は同じコードを仮想クロックで数か月分動かす。
+//
+// 時刻はmillis()と同じ32bitのミリ秒で、約49.7日で一周する。
+// 期限との比較は差を符号付きで見る（clockReached）ので、一周をまたいでも正しく比べられる。
+#pragma once
+
+#include <Arduino.h>
+
+// 目の動きの設定
+constexpr int MOVE_INTERVAL_MIN = 2000; // 目の動きの最小間隔（ミリ秒）
+constexpr int MOVE_INTERVAL_MAX = 5000; // 目の動きの最大間隔（ミリ秒）
+constexpr int MOVE_DURATION = 200;      // 目の動きの持続時間（ミリ秒）
+constexpr int MOVE_PAUSE = 3000;        // 動き終わってから次の動きまでの時間（ミリ秒）
+constexpr int BLINK_INTERVAL = 3100;    // 瞬きの間隔（ミリ秒）
+constexpr int BLINK_DURATION = 200;     // 瞬きの持続時間（ミリ秒）
+
+// 表情の設定
+// 通常の目で表情を自動で切り替えるかどうか
+// （falseなら開いた目のままで、表情はeyeStateSetExpressionで明示的に切り替える）
+constexpr bool EXPRESSION_AUTO_CYCLE = false;
+constexpr int EXPRESSION_INTERVAL_MIN = 4000;  // 表情を自動で切り替える最小間隔（ミリ秒）
+constexpr int EXPRESSION_INTERVAL_MAX = 9000;  // 表情を自動で切り替える最大間隔（ミリ秒）
+constexpr int EXPRESSION_MORPH_DURATION = 250; // 表情の切り替えにかける時間（ミリ秒）
+
+// モード切替の定数
+constexpr int NORMAL_EYE_DURATION = 9000;    // 通常の目モードの持続時間（ミリ秒）
+constexpr int SLOT_MACHINE_DURATION = 10000; // スロットマシンモードの持続時間（ミリ秒）
+constexpr int SLEEP_MODE_DURATION = 10000;   // おやすみモードの持続時間（ミリ秒）
+constexpr int SLOT_SCROLL_DURATION = 1500;   // スロットの開始で目を下に流す時間（ミリ秒）
+constexpr int SLOT_SPIN_DURATION = 3000;     // スロットの回転時間（ミリ秒）
+constexpr int SLOT_RESULT_DURATION = 3000;   // スロットの結果を表示する時間（ミリ秒）
+constexpr int SLEEP_NORMAL_DURATION = 3000;  // おやすみモードで目を開けている時間（ミリ秒）
+constexpr int SLEEP_CLOSING_DURATION = 500;  // おやすみモードで目を閉じる時間（ミリ秒）
+constexpr int SLEEP_DIMMING_DURATION = 2000; // おやすみモードで画面を暗くする時間（ミリ秒）
+constexpr int DISPLAY_BRIGHTNESS = 200;      // 通常の画面の明るさ
+
+// ウィンカーの設定
+constexpr int WINKER_BLINK_INTERVAL = 500; // ウィンカー点滅間隔（ミリ秒）
+
+// 位置の精度
+constexpr int SUBPIXEL_SHIFT = 2;                   // サブピクセルの精度（2なら1/4ピクセル）
+constexpr int SUBPIXEL_STEPS = 1 << SUBPIXEL_SHIFT; // 1ピクセルあたりの位相の数
+
+// ピクセル単位からサブピクセル単位へ
+inline int toSubpixel(int pixel)
+{
+  return pixel * SUBPIXEL_STEPS;
+}
+
+// サブピクセル単位からピクセル単位へ（負の値も切り捨て）
+inline int subpixelToPixel(int subpixel)
+{
+  return subpixel >> SUBPIXEL_SHIFT;
+}
+
+// 時刻nowが期限deadlineに達したかどうか（millis()の一周をまたいでも正しく比べる）
+// 期限との差が約24.8日以内であることが前提
+inline bool clockReached(uint32_t now, uint32_t deadline)
+{
+  return (int32_t)(now - deadline) >= 0;
+}
+
+// 目の表情
+enum EyeExpression
+{
+  EXPRESSION_OPEN,        // 開いた目（通常の四角い目）
+  EXPRESSION_HALF_CLOSED, // 半分閉じた目
+  EXPRESSION_HAPPY,       // 笑った目（上向きの弧）
+  EXPRESSION_ANGRY,       // 怒った目（内側が下がった斜め）
+  EXPRESSION_SURPRISED,   // 驚いた目（大きな丸）
+  EXPRESSION_SLEEPY,      // 眠そうな目
+  EXPRESSION_CLOSED,      // 閉じた目（瞬き・おやすみ用）
+  EXPRESSION_COUNT        // 表情の数
+};
+
+// 目のモード
+enum EyeMode
+{
+  NORMAL_EYE = 0,   // 通常の目（四角い目）
+  SLOT_MACHINE = 1, // スロットマシンモード
+  SLEEP_MODE = 2,   // おやすみモード
+  EYE_MODE_COUNT    // モードの数
+};
+
+// スロットマシンの状態
+enum SlotState
+{
+  SLOT_START,    // 開始状態
+  SLOT_SPINNING, // 回転中
+  SLOT_RESULT,   // 結果表示中
+  SLOT_END       // 終了状態
+};
+
+// おやすみモードの状態
+enum SleepState
+{
+  SLEEP_START,   // 開始状態
+  SLEEP_NORMAL,  // 通常の目を表示
+  SLEEP_CLOSING, // 目を閉じている途中
+  SLEEP_DIMMING, // 画面を暗くしている途中
+  SLEEP_COMPLETE // 完全に暗くなった状態
+};
+
+// 目の位置情報（中央からのずれ、1/SUBPIXEL_STEPSピクセル単位）
+struct EyePosition
+{
+  int x;
+  int y;
+};
+
+// 目の状態
+struct EyeState
+{
+  EyePosition leftEye;          // 現在の左目の位置
+  EyePosition rightEye;         // 現在の右目の位置
+  EyePosition prevLeftEye;      // 前回の左目の位置
+  EyePosition prevRightEye;     // 前回の右目の位置
+  uint32_t nextMoveTime;        // 次の動きの時間
+  bool isMoving;                // 動き中フラグ
+  uint32_t moveStartTime;       // 動きの開始時間
+  EyePosition targetLeft;       // 目標の左目位置
+  EyePosition targetRight;      // 目標の右目位置
+  EyePosition originalLeft;     // 動き開始時の左目位置
+  EyePosition originalRight;    // 動き開始時の右目位置
+  bool initialized;             // 初期化済みフラグ
+  EyeMode mode;                 // 目のモード
+  uint32_t nextBlinkTime;       // 次の瞬きの時間
+  bool isBlinking;              // 瞬き中フラグ
+  uint32_t blinkStartTime;      // 瞬きの開始時間
+  bool lookingAtCenter;         // センターを見ているかどうか
+  uint32_t modeStartTime;       // モード開始時間
+  SlotState slotState;          // スロットマシンの状態
+  uint32_t slotStartTime;       // スロット開始時間
+  int slotNumber;               // スロットの結果の数字
+  SleepState sleepState;        // おやすみモードの状態
+  uint32_t sleepStartTime;      // おやすみモード開始時間
+  int brightness;               // 画面の明るさ（おやすみモード用）
+  bool touch3Pressed;           // タッチ3が押されたかどうか
+  bool touch3Released;          // タッチ3が離されたかどうか
+  uint32_t touch3Time;          // タッチ3が最後に押された時間
+  int modeSequence;             // モード切り替えのシーケンス（0: 通常, 1: スロット, 2: 通常, 3: おやすみ）
+  EyeExpression expression;     // 現在の表情（切り替え中は切り替え先）
+  EyeExpression prevExpression; // 切り替え前の表情
+  uint32_t expressionStartTime; // 表情の切り替え開始時間
+  uint32_t nextExpressionTime;  // 次に表情を切り替える時間
+};
+
+// ウィンカーの状態
+struct WinkerState
+{
+  bool on;                 // 点灯しているかどうか
+  uint32_t lastToggleTime; // 最後に状態を切り替えた時間
+};
+
+void eyeStateReset(EyeState &state, uint32_t now); // 初期状態にする（起動時とトレース再生の開始時）
+
+// 時間切れのモードを通常の目に戻す（戻したらtrue、明るさはbrightnessに戻してある）
+bool eyeStateUpdateMode(EyeState &state, uint32_t now);
+
+// タッチ3の入力でモードを切り替える（離したときに次のモードへ進めたらtrue、明るさはbrightnessに戻してある）
+bool eyeStateTouchMode(EyeState &state, bool touched, uint32_t now);
+
+// 通常の目の瞬き・表情・視線の移動を進める（再描画が必要ならtrue）
+// maxMove: 視線を動かす範囲（ピクセル、中央から上下左右）
+bool eyeStateUpdateNormal(EyeState &state, uint32_t now, int maxMove);
+
+// 表情を切り替える（EXPRESSION_MORPH_DURATIONかけて今の形から変わる）
+void eyeStateSetExpression(EyeState &state, EyeExpression expression, uint32_t now);
+
+void eyeStateAdvanceSlot(EyeState &state, uint32_t now); // スロットマシンの状態遷移を進める
+
+// おやすみモードの状態遷移を進める（明るさを変えたらtrue）
+bool eyeStateAdvanceSleep(EyeState &state, uint32_t now);
+
+// ウィンカーを点滅させる（タッチ中は一定間隔で切り替え、離したら消す。点灯状態が変わったらtrue）
+bool winkerUpdate(WinkerState &winker, bool touched, uint32_t now);
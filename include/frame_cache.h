@@ -0,0 +1,37 @@
+// 描画状態をキーにしたフレームのキャッシュ
+// 目の位置・表情・瞬きの進み具合やスロットの結果の数字など、描く内容を決める状態の組をキーにして、
+// ラスタライズした結果（描画した範囲のピクセル）をランレングス圧縮して持っておく。
+// 同じキーのフレームはラスタライズせずにスプライトへ展開し、そのまま転送の経路に渡す。
+//
+// ターゲット（スプライト）ごとに領域と表を分けるので、2つのコアが別々のターゲットを
+// 同時に描いていてもロックはいらない。領域があふれたら最も長く使っていないエントリを捨てる。
+// 一度しか現れない状態（移動中の位置など）で表が入れ替わらないよう、登録は同じキーの2回目のミスから。
+//
+// ランの形式: count(u16), value(u16)（8bitカラーのスプライトでは値の下位8bitだけを使う）
+#pragma once
+
+#include <Arduino.h>
+#include "render_target.h"
+
+constexpr size_t FRAME_CACHE_BYTES = 24 * 1024; // 圧縮したフレームに使う領域（ターゲットごとに等分）
+constexpr int FRAME_CACHE_TARGETS = 2;          // ターゲットの数
+constexpr int FRAME_CACHE_ENTRIES = 12;         // ターゲットごとのエントリの最大数
+constexpr int FRAME_CACHE_CANDIDATES = 8;       // 1回目のミスを覚えておくキーの数（ターゲットごと）
+
+// キャッシュの統計
+struct FrameCacheStats
+{
+  uint32_t lookups;   // 検索した回数
+  uint32_t hits;      // ヒットした回数
+  uint32_t inserts;   // 登録した回数
+  uint32_t evictions; // 領域をあけるために捨てた回数
+  uint32_t rejected;  // 領域に収まらず登録しなかった回数
+  uint32_t bytes;     // 使用中のバイト数
+  uint32_t capacity;  // 領域のバイト数
+  int entries;        // 登録中のエントリ数
+};
+
+bool frameCacheBegin();                                              // 領域を確保する（フレームバッファのあとに1回）
+bool frameCacheLookup(int slot, uint64_t key, RenderTarget &target); // 登録済みならターゲットに展開する
+void frameCacheStore(int slot, uint64_t key, RenderTarget &target);  // ラスタライズした結果を登録する
+FrameCacheStats frameCacheStats();                                   // 統計（全ターゲットの合計）
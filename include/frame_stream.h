@@ -0,0 +1,34 @@
+// 描画したフレームをUSB CDC経由でホストへ送るライブストリーム
+// 前回送ったフレームとのXOR差分を差分領域だけ1bpp（輝度の2値化）で取り出し、
+// ランレングス圧縮して送る。ホスト側は tools/stream_viewer.py で表示する。
+//
+// パケット形式（リトルエンディアン）
+//   ヘッダ: sync(0xE5, 0x5E), flags(u8), rectCount(u8), frameIndex(u16), width(u16), height(u16)
+//   矩形ごと: x(u16), y(u16), w(u16), h(u16) に続いて、(w / 8) * h バイトのXOR差分を
+//             (count(u8), value(u8)) の組でランレングス圧縮したもの
+//   flags の bit0 はキーフレーム（ホストは適用前に画面を0で初期化する）
+#pragma once
+
+#include <Arduino.h>
+#include "render_target.h"
+
+constexpr uint8_t STREAM_SYNC0 = 0xE5;
+constexpr uint8_t STREAM_SYNC1 = 0x5E;
+constexpr uint8_t STREAM_FLAG_KEYFRAME = 0x01;
+constexpr int STREAM_MAX_RECTS = 4; // 1フレームあたりの矩形の最大数（ターゲットごとに1つ）
+
+// ストリームの統計
+struct FrameStreamStats
+{
+  uint32_t frames;       // 送信したフレーム数
+  uint32_t skipped;      // 送信できずに次へ持ち越したフレーム数
+  uint32_t bytes;        // 送信したバイト数
+  uint32_t encodeMicros; // 符号化にかかった時間の合計（マイクロ秒）
+  uint32_t maxMicros;    // 1フレームの符号化時間の最大値（マイクロ秒）
+};
+
+bool frameStreamBegin(int width, int height); // 前回フレームの保持用バッファを確保する
+void frameStreamSetEnabled(bool enabled);     // ストリームの開始／停止（開始時はキーフレームを送る）
+bool frameStreamEnabled();
+void frameStreamSubmit(RenderTarget *targets, int count); // 転送済みのフレームを送る
+const FrameStreamStats &frameStreamStats();
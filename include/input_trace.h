@@ -0,0 +1,77 @@
+// 入力トレースの記録と再生
+// タッチピンのエッジ・モード遷移・乱数シードをRAM上のリングバッファに記録し、
+// シリアル経由でダンプ／ロードできるようにする。
+// 再生時は仮想クロックで状態遷移を駆動し、実時間より速く同じ入力を再現する。
+#pragma once
+
+#include <Arduino.h>
+
+constexpr uint32_t TRACE_MAGIC = 0x52545945; // "EYTR"（リトルエンディアン）
+constexpr uint16_t TRACE_VERSION = 1;        // トレース形式のバージョン
+constexpr size_t TRACE_CAPACITY = 2048;      // リングバッファのレコード数（8バイト×2048 = 16KB）
+constexpr int TRACE_TOUCH_COUNT = 4;         // 記録するタッチピンの数
+
+// トレースレコードの種類
+enum TraceEventType : uint8_t
+{
+  TRACE_TOUCH_EDGE = 1,  // タッチピンのエッジ（arg: タッチ番号, value: 新しいレベル）
+  TRACE_MODE_CHANGE = 2, // モード遷移（arg: 新しいモード, value: モードシーケンス）
+};
+
+// トレースレコード（8バイト固定長）
+struct __attribute__((packed)) TraceRecord
+{
+  uint32_t time;  // 記録時刻（millis()）
+  uint8_t type;   // TraceEventType
+  uint8_t arg;    // 種類ごとの引数
+  uint16_t value; // 種類ごとの値
+};
+
+// トレースヘッダ（ダンプの先頭に出力される）
+struct __attribute__((packed)) TraceHeader
+{
+  uint32_t magic;      // TRACE_MAGIC
+  uint16_t version;    // TRACE_VERSION
+  uint16_t recordSize; // sizeof(TraceRecord)
+  uint32_t seed;       // 記録開始時の乱数シード
+  uint32_t startTime;  // 記録開始時刻（millis()）
+  uint32_t count;      // 保持しているレコード数
+  uint32_t dropped;    // リングバッファの上書きで失われたレコード数
+};
+
+// 再生結果の統計
+struct ReplayStats
+{
+  uint32_t frames;        // 実行したフレーム数
+  uint32_t totalMicros;   // フレーム処理時間の合計（マイクロ秒）
+  uint32_t maxMicros;     // フレーム処理時間の最大値（マイクロ秒）
+  uint32_t virtualMillis; // 再生した仮想時間（ミリ秒）
+  uint32_t wallMillis;    // 再生にかかった実時間（ミリ秒）
+  uint32_t divergences;   // 記録と一致しなかったモード遷移の数
+  uint32_t histogram[8];  // フレーム処理時間の分布（1ms, 2ms, 4ms, ... 64ms以上）
+};
+
+// 時刻の取得（仮想クロック有効時は仮想時刻を返す）
+unsigned long clockMillis();
+void clockUseVirtual(unsigned long startTime); // 仮想クロックに切り替える
+void clockAdvanceTo(unsigned long time);       // 仮想クロックを指定時刻に進める
+void clockUseReal();                           // 実時間のクロックに戻す
+bool clockIsVirtual();                         // 仮想クロックが有効かどうか
+
+// 記録
+void traceBegin(uint32_t seed, unsigned long startTime); // 記録を(再)開始する
+bool traceTouch(int index, bool level);                  // タッチ入力を通し、エッジを記録する
+void traceModeChange(uint8_t mode, uint8_t sequence);    // モード遷移を記録する
+const TraceHeader &traceHeader();                        // 現在のヘッダ
+size_t traceCount();                                     // 保持しているレコード数
+const TraceRecord &traceAt(size_t index);                // 古い順にレコードを取得
+void traceDump(Print &out);                              // バイナリでダンプする
+bool traceLoad(Stream &in);                              // バイナリを読み込む（記録は停止する）
+
+// 再生
+// 再生を開始（記録を止め、入力を注入に切り替え）
+// tolerance: モード遷移の時刻の許容差（ミリ秒）。再生は一定間隔でフレームを進めるので、
+// 時間切れによる遷移は記録された時刻より最大1フレーム早く起きる。
+void traceReplayBegin(uint32_t tolerance);
+void traceReplayInject(const TraceRecord &record); // タッチエッジを注入する
+uint32_t traceReplayEnd();                         // 再生を終了し、モード遷移の不一致数を返す
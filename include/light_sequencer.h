@@ -0,0 +1,34 @@
+// アドレス指定可能なLEDテープ（WS2812系）でライトを光らせるパターンシーケンサー
+// ウィンカー・ヘッドライト・ブレーキライトのピンにそれぞれLEDテープをつなぎ、
+// RMTペリフェラルで信号を出す（CPUでビットを出力しない）。
+// パターンは表（ステップの並び）で定義し、表示内容が変わったときだけRMTの送信データを作り直す。
+#pragma once
+
+#include <Arduino.h>
+
+constexpr int LIGHT_STRIP_LENGTH = 8; // 1本のLEDテープのLED数
+
+// ライトの系統（RMTのチャンネルに対応）
+enum LightChannel
+{
+  LIGHT_WINKER_R = 0, // 右ウィンカー
+  LIGHT_WINKER_L = 1, // 左ウィンカー
+  LIGHT_HEAD = 2,     // ヘッドライト
+  LIGHT_BRAKE = 3,    // ブレーキライト
+  LIGHT_CHANNEL_COUNT
+};
+
+// 点灯パターン
+enum LightPattern
+{
+  PATTERN_OFF,              // 消灯
+  PATTERN_TURN_SEQUENTIAL,  // 流れるウィンカー
+  PATTERN_HAZARD,           // ハザード（全体の点滅）
+  PATTERN_BRAKE_FLASH,      // ブレーキ（数回点滅してから点灯し続ける）
+  PATTERN_HEADLIGHT_FADEIN, // ヘッドライト（ふわっと点灯して点灯し続ける）
+  LIGHT_PATTERN_COUNT
+};
+
+bool lightSequencerBegin(const int pins[LIGHT_CHANNEL_COUNT]); // RMTのチャンネルを初期化する
+void lightSetPattern(LightChannel channel, LightPattern pattern, unsigned long currentTime); // パターンを切り替える（同じパターンなら継続）
+void lightUpdate(unsigned long currentTime); // パターンを進め、変化があればRMTで送信する
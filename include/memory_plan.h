@@ -0,0 +1,19 @@
+// メモリ計画
+// フレームバッファなどの大きな領域は起動時に一度だけ確保し、以後は確保・解放しない。
+// 確保した領域の一覧と、空きヒープ・最大の空きブロック・タスクのスタックの残りを報告する。
+#pragma once
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+constexpr size_t MEMORY_PLAN_ALIGNMENT = 16;                                    // 確保する領域のアラインメント（DMAの転送に合わせる）
+constexpr uint32_t MEMORY_PLAN_DMA_CAPS = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL; // DMAで転送できる内部RAM
+constexpr int MEMORY_PLAN_MAX_BLOCKS = 8;                                       // 記録する確保の最大数
+constexpr int MEMORY_PLAN_MAX_TASKS = 4;                                        // スタックを監視するタスクの最大数
+
+// 領域を確保して0で埋める（確保できなければnullptr、失敗も報告に残る）
+void *memoryPlanReserve(const char *name, size_t bytes, uint32_t caps = MEMORY_PLAN_DMA_CAPS);
+void memoryPlanRelease(void *block);                           // 確保した領域を戻す（フォールバックに切り替えるときのみ）
+size_t memoryPlanReservedBytes();                              // 確保済みの合計
+void memoryPlanWatchTask(const char *name, TaskHandle_t task); // スタックの残りを報告するタスクを登録する
+void memoryPlanReport(Print &out);                             // 確保の一覧とヒープ・スタックの状態を出力する
@@ -0,0 +1,33 @@
+// 描画量（オーバードロー）と転送量の計測
+// ラスタライズ先への書き込みと、パネルへの転送をフレームごとに矩形単位で数え、
+// 目のモードと状態の区分ごとに、ヒートマップ（マスごとの合計）と統計に集計する。
+// 書き込みは描画命令の範囲で数える（文字や線は外接矩形の分を数えるので多めに出る）。
+// 計測中は2コア描画でも同じコアで順にラスタライズし、カウンタを取り合わないようにする。
+//
+// 出力（シリアルのテキスト）
+//   overdraw: 区分ごとに フレーム数, 1フレームの書き込みピクセル数（平均と最大）, オーバードロー率
+//             （書き込み / フレームバッファのピクセル数）, うち背景の塗りつぶしの割合,
+//             1フレームの転送バイト数, 転送した割合（転送 / フレームバッファ全体）
+//   ヒートマップは区分ごとに書き込みと転送の2枚を、マスを1ピクセルとしたPGM（P2）で出力する。
+//   濃さは1フレームあたりの回数で、64が1ピクセルに1回（255で頭打ち）。
+//   tools/overdraw_capture.py で画像ファイルに保存できる。
+#pragma once
+
+#include <Arduino.h>
+
+constexpr int OVERDRAW_CELL = 16;        // ヒートマップの1マスの大きさ（ピクセル）
+constexpr int OVERDRAW_MAX_BUCKETS = 16; // 集計する区分の最大数
+constexpr int OVERDRAW_PANEL_BYTES = 2;  // パネルに送る1ピクセルのバイト数（RGB565）
+constexpr int OVERDRAW_LEVEL_ONE = 64;   // ヒートマップで1ピクセルに1回を表す濃さ
+
+// 集計を始める（width, height: 論理フレームの大きさ、framebufferPixels: 1フレームで描くフレームバッファのピクセル数）
+// 集計用の領域は最初の1回だけ確保し、2回目以降は集計をやり直す
+bool overdrawBegin(int width, int height, uint32_t framebufferPixels, const char *const *bucketNames, int bucketCount);
+void overdrawStop();                                 // 集計を止める（結果は残る）
+bool overdrawEnabled();
+void overdrawFrameBegin(int bucket);                 // フレームの計測を始める（区分を指定）
+void overdrawFrameEnd();                             // フレームの計測を終えて区分に加える
+void overdrawCountClear(int x, int y, int w, int h); // 背景の塗りつぶし（論理フレーム座標、クリップ済み）
+void overdrawCountWrite(int x, int y, int w, int h); // 描画した範囲（論理フレーム座標、クリップ済み）
+void overdrawCountPush(int x, int y, int w, int h);  // パネルへ転送した範囲（論理フレーム座標）
+void overdrawReport(Print &out);                     // 区分ごとの統計とヒートマップを出力する
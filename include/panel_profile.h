@@ -0,0 +1,223 @@
+// パネル・レイアウトのプロファイル
+// パネルごとのピン配置・解像度・回転・色深度と、目や数字の寸法をconstexprの構造体にまとめる。
+// 描画関数はプロファイルを型引数にとるテンプレートとして実体化されるため、
+// レイアウトの計算はすべてコンパイル時に畳み込まれる。
+// 使用するプロファイルはビルドフラグで選ぶ（platformio.ini の環境を参照）。
+#pragma once
+
+#include <M5Unified.h>
+#include <lgfx/v1/panel/Panel_ST7789.hpp>
+
+// 320x240のST7789（240x320のパネルを横向きで使用）
+// ST7789: https://www.amazon.co.jp/gp/product/B07QG93NPB/
+struct PanelST7789_320x240
+{
+  using PanelDriver = lgfx::Panel_ST7789;
+
+  // ピン
+  static constexpr int PIN_SCL = 1;  // SCLK(SPI Clock) (SCL)
+  static constexpr int PIN_SDA = 3;  // MOSI (SDA)
+  static constexpr int PIN_RST = 5;  // Reset
+  static constexpr int PIN_DC = 7;   // Data/Command
+  static constexpr int PIN_BLK = 44; // Backlight
+  static constexpr int PIN_CS = 43;  // Chip Select
+
+  // パネル
+  static constexpr int PANEL_COUNT = 1;    // パネルの枚数
+  static constexpr int PANEL_WIDTH = 240;  // パネル本来の幅
+  static constexpr int PANEL_HEIGHT = 320; // パネル本来の高さ
+  static constexpr int OFFSET_X = 0;       // パネルのメモリ上のオフセットX
+  static constexpr int OFFSET_Y = 0;       // パネルのメモリ上のオフセットY
+  static constexpr int ROTATION = 3;       // 回転
+  static constexpr bool INVERT = true;     // 明暗の反転
+  static constexpr int COLOR_DEPTH = 16;   // スプライトの色深度
+
+  // 回転後の表示領域
+  static constexpr int DISPLAY_WIDTH = 320;  // ディスプレイの幅
+  static constexpr int DISPLAY_HEIGHT = 240; // ディスプレイの高さ
+
+  // メモリ（StampS3はPSRAMがないので、フレームバッファは内部RAMから確保する）
+  static constexpr size_t FRAMEBUFFER_BUDGET = 208 * 1024; // フレームバッファ・ストリームの保持バッファ・キャッシュ・トランジションに使える量
+
+  // 目
+  static constexpr int EYE_SPACING = 190;       // 目の間隔
+  static constexpr int SQUARE_EYE_WIDTH = 60;   // 四角い目の幅
+  static constexpr int SQUARE_EYE_HEIGHT = 120; // 四角い目の高さ
+  static constexpr int SQUARE_EYE_RADIUS = 5;   // 四角い目の角の丸み
+
+  // スロットマシンの数字
+  static constexpr int TEXT_SIZE = 10;             // 文字サイズ（標準フォント6x8の倍率）
+  static constexpr int DIGIT_OFFSET_X = 30;        // 目の中心から数字の左端まで
+  static constexpr int DIGIT_OFFSET_Y = 35;        // 画面の中心から数字の上端まで
+  static constexpr int INTRO_DIGIT_OFFSET_X = 25;  // 開始時に流れてくる数字の左端まで
+  static constexpr int INTRO_DIGIT_START_Y = -300; // 開始時に流れてくる数字の初期位置
+  static constexpr int DIGIT_PITCH = 80;           // ドラムリールの数字の間隔
+};
+
+// 240x240のST7789
+struct PanelST7789_240x240
+{
+  using PanelDriver = lgfx::Panel_ST7789;
+
+  // ピン
+  static constexpr int PIN_SCL = 1;  // SCLK(SPI Clock) (SCL)
+  static constexpr int PIN_SDA = 3;  // MOSI (SDA)
+  static constexpr int PIN_RST = 5;  // Reset
+  static constexpr int PIN_DC = 7;   // Data/Command
+  static constexpr int PIN_BLK = 44; // Backlight
+  static constexpr int PIN_CS = 43;  // Chip Select
+
+  // パネル
+  static constexpr int PANEL_COUNT = 1;    // パネルの枚数
+  static constexpr int PANEL_WIDTH = 240;  // パネル本来の幅
+  static constexpr int PANEL_HEIGHT = 240; // パネル本来の高さ
+  static constexpr int OFFSET_X = 0;       // パネルのメモリ上のオフセットX
+  static constexpr int OFFSET_Y = 0;       // パネルのメモリ上のオフセットY
+  static constexpr int ROTATION = 0;       // 回転
+  static constexpr bool INVERT = true;     // 明暗の反転
+  static constexpr int COLOR_DEPTH = 16;   // スプライトの色深度
+
+  // 回転後の表示領域
+  static constexpr int DISPLAY_WIDTH = 240;  // ディスプレイの幅
+  static constexpr int DISPLAY_HEIGHT = 240; // ディスプレイの高さ
+
+  // メモリ（StampS3はPSRAMがないので、フレームバッファは内部RAMから確保する）
+  static constexpr size_t FRAMEBUFFER_BUDGET = 208 * 1024; // フレームバッファ・ストリームの保持バッファ・キャッシュ・トランジションに使える量
+
+  // 目
+  static constexpr int EYE_SPACING = 130;       // 目の間隔
+  static constexpr int SQUARE_EYE_WIDTH = 48;   // 四角い目の幅
+  static constexpr int SQUARE_EYE_HEIGHT = 100; // 四角い目の高さ
+  static constexpr int SQUARE_EYE_RADIUS = 4;   // 四角い目の角の丸み
+
+  // スロットマシンの数字
+  static constexpr int TEXT_SIZE = 7;              // 文字サイズ（標準フォント6x8の倍率）
+  static constexpr int DIGIT_OFFSET_X = 21;        // 目の中心から数字の左端まで
+  static constexpr int DIGIT_OFFSET_Y = 25;        // 画面の中心から数字の上端まで
+  static constexpr int INTRO_DIGIT_OFFSET_X = 18;  // 開始時に流れてくる数字の左端まで
+  static constexpr int INTRO_DIGIT_START_Y = -210; // 開始時に流れてくる数字の初期位置
+  static constexpr int DIGIT_PITCH = 56;           // ドラムリールの数字の間隔
+};
+
+// 片目に1枚ずつ、2枚の240x240のST7789
+// 2枚は同じSPIバスにつなぎ、CSだけを分ける（リセット・D/C・バックライトは共通）。
+// 論理フレームは2枚を横に並べた480x240で、パネルごとに目のまわりの縦長の範囲（ウィンドウ）だけを
+// フレームバッファに持って描画・転送する。ウィンドウの外は起動時に黒で塗ったまま触らない。
+struct PanelST7789_240x240_Dual
+{
+  using PanelDriver = lgfx::Panel_ST7789;
+
+  // ピン
+  static constexpr int PIN_SCL = 1;       // SCLK(SPI Clock) (SCL)
+  static constexpr int PIN_SDA = 3;       // MOSI (SDA)
+  static constexpr int PIN_RST = 5;       // Reset（2枚共通）
+  static constexpr int PIN_DC = 7;        // Data/Command（2枚共通）
+  static constexpr int PIN_BLK = 44;      // Backlight（2枚共通）
+  static constexpr int PIN_CS = 43;       // Chip Select（左目）
+  static constexpr int PIN_CS_RIGHT = 13; // Chip Select（右目）
+
+  // パネル
+  static constexpr int PANEL_COUNT = 2;    // パネルの枚数（片目に1枚）
+  static constexpr int PANEL_WIDTH = 240;  // パネル本来の幅
+  static constexpr int PANEL_HEIGHT = 240; // パネル本来の高さ
+  static constexpr int OFFSET_X = 0;       // パネルのメモリ上のオフセットX
+  static constexpr int OFFSET_Y = 0;       // パネルのメモリ上のオフセットY
+  static constexpr int ROTATION = 0;       // 回転
+  static constexpr bool INVERT = true;     // 明暗の反転
+  static constexpr int COLOR_DEPTH = 16;   // スプライトの色深度
+
+  // 回転後の表示領域（2枚を横に並べた論理フレーム）
+  static constexpr int DISPLAY_WIDTH = 480;    // ディスプレイの幅
+  static constexpr int DISPLAY_HEIGHT = 240;   // ディスプレイの高さ
+  static constexpr int EYE_WINDOW_WIDTH = 160; // パネルごとのフレームバッファの幅（高さはパネルと同じ）
+
+  // メモリ（StampS3はPSRAMがないので、フレームバッファは内部RAMから確保する）
+  static constexpr size_t FRAMEBUFFER_BUDGET = 208 * 1024; // フレームバッファ・ストリームの保持バッファ・キャッシュ・トランジションに使える量
+
+  // 目
+  static constexpr int EYE_SPACING = 240;       // 目の間隔（パネルの中心どうし）
+  static constexpr int SQUARE_EYE_WIDTH = 96;   // 四角い目の幅
+  static constexpr int SQUARE_EYE_HEIGHT = 180; // 四角い目の高さ
+  static constexpr int SQUARE_EYE_RADIUS = 8;   // 四角い目の角の丸み
+
+  // スロットマシンの数字
+  static constexpr int TEXT_SIZE = 14;             // 文字サイズ（標準フォント6x8の倍率）
+  static constexpr int DIGIT_OFFSET_X = 42;        // 目の中心から数字の左端まで
+  static constexpr int DIGIT_OFFSET_Y = 56;        // 画面の中心から数字の上端まで
+  static constexpr int INTRO_DIGIT_OFFSET_X = 35;  // 開始時に流れてくる数字の左端まで
+  static constexpr int INTRO_DIGIT_START_Y = -420; // 開始時に流れてくる数字の初期位置
+  static constexpr int DIGIT_PITCH = 112;          // ドラムリールの数字の間隔
+};
+
+// 論理フレームを横Columns×縦Rowsのタイルに分け、タイルごとに1組の目を描くときのプロファイル
+// 表示領域をタイルの大きさにし、目と数字の寸法は縦横の分割数の大きいほうで割って縮める（1×1ならパネルのまま）。
+// ピン・パネル・メモリの設定はパネルのものをそのまま使う。
+template <typename Panel, int Columns, int Rows>
+struct PanelTiles : Panel
+{
+  static constexpr int TILE_SCALE = Columns > Rows ? Columns : Rows; // 寸法を割る数
+
+  // タイルの表示領域
+  static constexpr int DISPLAY_WIDTH = Panel::DISPLAY_WIDTH / Columns; // タイルの幅
+  static constexpr int DISPLAY_HEIGHT = Panel::DISPLAY_HEIGHT / Rows;  // タイルの高さ
+
+  // 目
+  static constexpr int EYE_SPACING = Panel::EYE_SPACING / TILE_SCALE;
+  static constexpr int SQUARE_EYE_WIDTH = Panel::SQUARE_EYE_WIDTH / TILE_SCALE;
+  static constexpr int SQUARE_EYE_HEIGHT = Panel::SQUARE_EYE_HEIGHT / TILE_SCALE;
+  static constexpr int SQUARE_EYE_RADIUS = Panel::SQUARE_EYE_RADIUS / TILE_SCALE;
+
+  // スロットマシンの数字
+  static constexpr int TEXT_SIZE = Panel::TEXT_SIZE / TILE_SCALE;
+  static constexpr int DIGIT_OFFSET_X = Panel::DIGIT_OFFSET_X / TILE_SCALE;
+  static constexpr int DIGIT_OFFSET_Y = Panel::DIGIT_OFFSET_Y / TILE_SCALE;
+  static constexpr int INTRO_DIGIT_OFFSET_X = Panel::INTRO_DIGIT_OFFSET_X / TILE_SCALE;
+  static constexpr int INTRO_DIGIT_START_Y = Panel::INTRO_DIGIT_START_Y / TILE_SCALE;
+  static constexpr int DIGIT_PITCH = Panel::DIGIT_PITCH / TILE_SCALE;
+
+  static_assert(Columns >= 1 && Rows >= 1, "a panel has at least one tile");
+  static_assert(TEXT_SIZE >= 1 && SQUARE_EYE_RADIUS >= 1, "tiles are too small for the eyes and digits");
+};
+
+// プロファイルから導出するレイアウト（すべてコンパイル時に決まる）
+template <typename Panel>
+struct EyeLayout : Panel
+{
+  static constexpr int DISPLAY_CENTER_X = Panel::DISPLAY_WIDTH / 2;  // ディスプレイの中心X
+  static constexpr int DISPLAY_CENTER_Y = Panel::DISPLAY_HEIGHT / 2; // ディスプレイの中心Y
+
+  // 中央を見ているときの目の左上
+  static constexpr int LEFT_EYE_X = DISPLAY_CENTER_X - Panel::EYE_SPACING / 2 - Panel::SQUARE_EYE_WIDTH / 2;
+  static constexpr int RIGHT_EYE_X = DISPLAY_CENTER_X + Panel::EYE_SPACING / 2 - Panel::SQUARE_EYE_WIDTH / 2;
+  static constexpr int EYE_Y = DISPLAY_CENTER_Y - Panel::SQUARE_EYE_HEIGHT / 2;
+
+  // 数字の大きさと位置
+  static constexpr int DIGIT_WIDTH = 6 * Panel::TEXT_SIZE;  // 数字の幅
+  static constexpr int DIGIT_HEIGHT = 8 * Panel::TEXT_SIZE; // 数字の高さ
+  static constexpr int LEFT_DIGIT_X = DISPLAY_CENTER_X - Panel::EYE_SPACING / 2 - Panel::DIGIT_OFFSET_X;
+  static constexpr int RIGHT_DIGIT_X = DISPLAY_CENTER_X + Panel::EYE_SPACING / 2 - Panel::DIGIT_OFFSET_X;
+  static constexpr int LEFT_INTRO_DIGIT_X = DISPLAY_CENTER_X - Panel::EYE_SPACING / 2 - Panel::INTRO_DIGIT_OFFSET_X;
+  static constexpr int RIGHT_INTRO_DIGIT_X = DISPLAY_CENTER_X + Panel::EYE_SPACING / 2 - Panel::INTRO_DIGIT_OFFSET_X;
+  static constexpr int DIGIT_Y = DISPLAY_CENTER_Y - Panel::DIGIT_OFFSET_Y;
+
+  // 目の動きの範囲
+  static constexpr int MAX_EYE_MOVE = Panel::SQUARE_EYE_WIDTH / 4;
+
+  // 表情で目の枠から左右にはみ出す幅（驚いた目は左右に枠の幅の1/12ずつ大きい）
+  static constexpr int EYE_BULGE_X = (Panel::SQUARE_EYE_WIDTH + 11) / 12;
+
+  static_assert(LEFT_EYE_X - MAX_EYE_MOVE - EYE_BULGE_X >= 0, "eyes do not fit the display width");
+  static_assert(RIGHT_EYE_X + Panel::SQUARE_EYE_WIDTH + MAX_EYE_MOVE + EYE_BULGE_X <= Panel::DISPLAY_WIDTH,
+                "eyes do not fit the display width");
+  static_assert(EYE_Y - MAX_EYE_MOVE >= 0, "eyes do not fit the display height");
+};
+
+// ビルドフラグで選択されたプロファイル
+#if defined(PANEL_PROFILE_ST7789_240X240)
+using ActivePanel = PanelST7789_240x240;
+#elif defined(PANEL_PROFILE_ST7789_240X240_DUAL)
+using ActivePanel = PanelST7789_240x240_Dual;
+#else
+using ActivePanel = PanelST7789_320x240;
+#endif
+using ActiveLayout = EyeLayout<ActivePanel>;
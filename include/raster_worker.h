@@ -0,0 +1,14 @@
+// もう一方のコア（core 0）でラスタライズを行うワーカー
+// Arduinoのloop()はcore 1で動くため、core 0に常駐タスクを置いてジョブを渡し、
+// タスク通知による軽量なフォーク・ジョインで同期する。
+#pragma once
+
+#include <Arduino.h>
+
+typedef void (*RasterJob)(void *context);
+
+bool rasterWorkerBegin(int core = 0);                // ワーカータスクを起動する
+void rasterWorkerFork(RasterJob job, void *context); // ジョブを投入する（ワーカーが無ければその場で実行）
+void rasterWorkerJoin();                             // 投入したジョブの完了を待つ（バリア）
+bool rasterWorkerBusy();                             // 完了待ちのジョブがあるかどうか
+TaskHandle_t rasterWorkerTask();                     // ワーカータスク（起動していなければnullptr）
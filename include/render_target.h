@@ -0,0 +1,227 @@
+// ラスタライズ先
+// 論理フレーム（画面全体）の座標で描画し、スプライト上の位置へ平行移動する。
+// フレームを複数のスプライト（タイル）に分割して描く場合も、描画コードは同じ座標のまま使える。
+// 描画した範囲（背景の黒以外を描いた範囲）を記録し、フレーム間の差分領域の計算に使う。
+//
+// 論理フレームの一部（目のセットの領域）を切り出したターゲットでは、領域の左上を原点とする座標で描画し、
+// 描画はスプライトのクリップで領域の中に制限される。描画した範囲も領域の座標で記録する。
+#pragma once
+
+#include <M5Unified.h>
+#include "overdraw_profiler.h"
+
+// 論理フレーム上の矩形領域（x1, y1 は含まない）
+struct DirtyRect
+{
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+
+  bool empty() const
+  {
+    return x0 >= x1 || y0 >= y1;
+  }
+
+  void clear()
+  {
+    x0 = y0 = x1 = y1 = 0;
+  }
+
+  // 矩形を追加して外接矩形に広げる
+  void add(int x, int y, int w, int h)
+  {
+    if (w <= 0 || h <= 0)
+    {
+      return;
+    }
+    if (empty())
+    {
+      x0 = x;
+      y0 = y;
+      x1 = x + w;
+      y1 = y + h;
+      return;
+    }
+    x0 = min(x0, x);
+    y0 = min(y0, y);
+    x1 = max(x1, x + w);
+    y1 = max(y1, y + h);
+  }
+
+  void merge(const DirtyRect &other)
+  {
+    if (!other.empty())
+    {
+      add(other.x0, other.y0, other.x1 - other.x0, other.y1 - other.y0);
+    }
+  }
+
+  // 別の矩形との共通部分に縮める
+  void intersect(int x, int y, int w, int h)
+  {
+    x0 = max(x0, x);
+    y0 = max(y0, y);
+    x1 = min(x1, x + w);
+    y1 = min(y1, y + h);
+    if (empty())
+    {
+      clear();
+    }
+  }
+};
+
+struct RenderTarget
+{
+  LGFX_Sprite *sprite; // 描画先のスプライト
+  int originX;         // スプライト左上のX座標（描画の座標、切り出していなければ論理フレーム座標）
+  int originY;         // スプライト左上のY座標
+  DirtyRect drawn;     // このフレームで描画した範囲（描画の座標、ターゲット内に制限）
+  float textSize;      // 現在の文字サイズ
+  int cursorX;         // 現在のカーソル位置（描画の座標）
+  int cursorY;
+  int regionX;         // 切り出した領域の左上の論理フレーム上のX座標（切り出していなければ0）
+  int regionY;         // 切り出した領域の左上の論理フレーム上のY座標
+  DirtyRect clip;      // 切り出した領域（描画の座標、空なら制限しない）
+
+  int width() const
+  {
+    return sprite->width();
+  }
+
+  int height() const
+  {
+    return sprite->height();
+  }
+
+  // 描画できる範囲（描画の座標、スプライトと切り出した領域の重なり）
+  DirtyRect bounds() const
+  {
+    DirtyRect rect = {originX, originY, originX + width(), originY + height()};
+    if (!clip.empty())
+    {
+      rect.intersect(clip.x0, clip.y0, clip.x1 - clip.x0, clip.y1 - clip.y0);
+    }
+    return rect;
+  }
+
+  // 描画の座標の(x, y)を左上とするw×hの領域を切り出す（描画した範囲は空から始める）
+  // 描く前にapplyClipでスプライトのクリップを領域に合わせ、描き終えたらreleaseClipで戻す。
+  RenderTarget region(int x, int y, int w, int h) const
+  {
+    RenderTarget view = *this;
+    view.originX = originX - x;
+    view.originY = originY - y;
+    view.regionX = regionX + x;
+    view.regionY = regionY + y;
+    view.clip = {0, 0, w, h};
+    view.drawn.clear();
+    return view;
+  }
+
+  void applyClip()
+  {
+    if (!clip.empty())
+    {
+      sprite->setClipRect(clip.x0 - originX, clip.y0 - originY, clip.x1 - clip.x0, clip.y1 - clip.y0);
+    }
+  }
+
+  void releaseClip()
+  {
+    sprite->clearClipRect();
+  }
+
+  // 描画した範囲を記録する（ターゲットの外側は除く）
+  void markDrawn(int x, int y, int w, int h)
+  {
+    DirtyRect rect = {x, y, x + w, y + h};
+    DirtyRect area = bounds();
+    rect.intersect(area.x0, area.y0, area.x1 - area.x0, area.y1 - area.y0);
+    drawn.merge(rect);
+    overdrawCountWrite(rect.x0 + regionX, rect.y0 + regionY, rect.x1 - rect.x0, rect.y1 - rect.y0);
+  }
+
+  // 背景を塗りつぶす（切り出した領域ではクリップした領域の中だけ）
+  void fillScreen(uint32_t color)
+  {
+    sprite->fillScreen(color);
+    DirtyRect area = bounds();
+    drawn.clear();
+    overdrawCountClear(area.x0 + regionX, area.y0 + regionY, area.x1 - area.x0, area.y1 - area.y0);
+    if (color != TFT_BLACK)
+    {
+      drawn = area;
+    }
+  }
+
+  void fillRoundRect(int x, int y, int w, int h, int r, uint32_t color)
+  {
+    sprite->fillRoundRect(x - originX, y - originY, w, h, r, color);
+    markDrawn(x, y, w, h);
+  }
+
+  void fillRect(int x, int y, int w, int h, uint32_t color)
+  {
+    sprite->fillRect(x - originX, y - originY, w, h, color);
+    markDrawn(x, y, w, h);
+  }
+
+  void drawFastHLine(int x, int y, int w, uint32_t color)
+  {
+    sprite->drawFastHLine(x - originX, y - originY, w, color);
+    markDrawn(x, y, w, 1);
+  }
+
+  void drawFastVLine(int x, int y, int h, uint32_t color)
+  {
+    sprite->drawFastVLine(x - originX, y - originY, h, color);
+    markDrawn(x, y, 1, h);
+  }
+
+  void drawPixel(int x, int y, uint32_t color)
+  {
+    sprite->drawPixel(x - originX, y - originY, color);
+    markDrawn(x, y, 1, 1);
+  }
+
+  void drawLine(int x0, int y0, int x1, int y1, uint32_t color)
+  {
+    sprite->drawLine(x0 - originX, y0 - originY, x1 - originX, y1 - originY, color);
+    markDrawn(min(x0, x1), min(y0, y1), abs(x1 - x0) + 1, abs(y1 - y0) + 1);
+  }
+
+  void setTextSize(float size)
+  {
+    sprite->setTextSize(size);
+    textSize = size;
+  }
+
+  void setTextColor(uint32_t color)
+  {
+    sprite->setTextColor(color);
+  }
+
+  void setCursor(int x, int y)
+  {
+    sprite->setCursor(x - originX, y - originY);
+    cursorX = x;
+    cursorY = y;
+  }
+
+  void printDigit(int digit)
+  {
+    sprite->printf("%d", digit);
+    // 標準フォント（6x8ピクセル）の1文字分
+    markDrawn(cursorX, cursorY, (int)(6 * textSize), (int)(8 * textSize));
+    cursorX += (int)(6 * textSize);
+  }
+
+  // 描画の座標の矩形が描画できる範囲と重なるかどうか
+  bool overlaps(int x, int y, int w, int h) const
+  {
+    DirtyRect area = bounds();
+    return x < area.x1 && x + w > area.x0 &&
+           y < area.y1 && y + h > area.y0;
+  }
+};
@@ -0,0 +1,39 @@
+// モード切り替えのトランジション（クロスフェード・ワイプ・ディゾルブ）
+// 切り替え前に表示していたフレームと、切り替え先の最初のフレームを、ターゲットごとに
+// 描画した範囲だけ行ごとのランレングス圧縮で取っておき（スナップショット）、
+// 2つのフレームの間を進み具合に応じて混ぜてスプライトに書き込む。
+// スプライトには切り替え先のフレームを描いておき、2つのフレームで値が違うランだけを書き換えるので、
+// トランジション中のコストは違う部分の混ぜ合わせだけで、2つの場面をラスタライズし直すことはない。
+// 混ぜ合わせはRGB565の3成分を32bitの1語に広げて一度に計算する（固定小数点）。
+//
+// 目のセットごとに独立して切り替えられるよう、領域はグループ（目のセット）ごとに等分して使う。
+//
+// ランの形式: count(u16), value(u16)（スプライトのバッファの値のまま、ランは行をまたがない）
+#pragma once
+
+#include <Arduino.h>
+#include "render_target.h"
+
+constexpr size_t TRANSITION_BYTES = 12 * 1024; // スナップショットに使う領域（グループごとに等分）
+constexpr int TRANSITION_TARGETS = 2;          // ターゲットの数
+constexpr int TRANSITION_GROUPS = 8;           // グループ（独立して切り替える目のセット）の最大数
+constexpr int TRANSITION_ONE = 256;            // 進み具合の1.0
+constexpr int TRANSITION_WIPE_EDGE = 16;       // ワイプの境目をぼかす幅（ピクセル）
+
+// 切り替え方
+enum TransitionStyle
+{
+  TRANSITION_CROSSFADE, // 全体を少しずつ混ぜる
+  TRANSITION_WIPE,      // 左から右へ境目を動かす
+  TRANSITION_DISSOLVE   // ピクセルごとに順に入れ替える（4x4の順序ディザ）
+};
+
+bool transitionBegin(int frameWidth, int groups); // 領域を確保してグループに分ける（frameWidth: 目のセットの画面の幅）
+void transitionReset(int group);                  // グループのスナップショットを捨てる（トランジションを始めるたびに呼ぶ）
+
+// 切り替え前のフレーム（いまスプライトにあるもの）を取っておく（領域が足りなければfalse）
+bool transitionCaptureFrom(int group, int slot, const RenderTarget &target);
+// 切り替え先のフレームを取っておく（スプライトはこのフレームのままにしておく）
+bool transitionCaptureTo(int group, int slot, const RenderTarget &target);
+// 進み具合（0〜TRANSITION_ONE）のフレームをスプライトに書き込み、描画した範囲を2つのフレームの外接矩形にする
+void transitionBlend(int group, int slot, RenderTarget &target, TransitionStyle style, int progress);
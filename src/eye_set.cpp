@@ -0,0 +1,72 @@
+// 目のセット（1組の目）のインスタンス
+#include "eye_set.h"
+
+void eyeSetBegin(EyeSet &set, EyeClock clock, int touchChannel, int maxMove)
+{
+  set.clock = clock;
+  set.touchChannel = touchChannel;
+  set.maxMove = maxMove;
+  eyeSetReset(set);
+}
+
+void eyeSetReset(EyeSet &set)
+{
+  set.now = set.clock();
+  eyeStateReset(set.state, set.now);
+}
+
+uint8_t eyeSetUpdate(EyeSet &set)
+{
+  set.now = set.clock();
+  EyeState &state = set.state;
+  uint8_t events = 0;
+
+  // スロットマシンとおやすみモードは時間経過で通常モードに戻る（明るさも元に戻す）
+  if (eyeStateUpdateMode(state, set.now))
+  {
+    events |= EYE_SET_MODE_CHANGED | EYE_SET_BRIGHTNESS_CHANGED;
+  }
+
+  switch (state.mode)
+  {
+  case SLOT_MACHINE:
+    // スロットマシンは常に描き直す
+    eyeStateAdvanceSlot(state, set.now);
+    events |= EYE_SET_REDRAW;
+    break;
+  case SLEEP_MODE:
+    // おやすみモードは常に描き直し、暗くしている間は明るさも変える
+    if (eyeStateAdvanceSleep(state, set.now))
+    {
+      events |= EYE_SET_BRIGHTNESS_CHANGED;
+    }
+    events |= EYE_SET_REDRAW;
+    break;
+  default:
+    // 通常の目は瞬き・表情・視線の移動に変化があったときだけ描き直す
+    if (eyeStateUpdateNormal(state, set.now, set.maxMove))
+    {
+      events |= EYE_SET_REDRAW;
+    }
+    break;
+  }
+  return events;
+}
+
+void eyeSetExpression(EyeSet &set, EyeExpression expression)
+{
+  eyeStateSetExpression(set.state, expression, set.now);
+}
+
+uint8_t eyeSetTouch(EyeSet &set, const bool *touches)
+{
+  if (set.touchChannel == EYE_SET_NO_TOUCH)
+  {
+    return 0;
+  }
+  if (!eyeStateTouchMode(set.state, touches[set.touchChannel], set.now))
+  {
+    return 0;
+  }
+  return EYE_SET_MODE_CHANGED | EYE_SET_BRIGHTNESS_CHANGED;
+}
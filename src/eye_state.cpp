@@ -0,0 +1,340 @@
+// 目の状態機械（モード・瞬き・視線の移動・表情・ウィンカー）
+#include "eye_state.h"
+
+void eyeStateReset(EyeState &state, uint32_t now)
+{
+  state = EyeState();
+  state.leftEye = {0, 0};
+  state.rightEye = {0, 0};
+  state.prevLeftEye = {0, 0};
+  state.prevRightEye = {0, 0};
+  state.isMoving = false;
+  state.initialized = false;
+  state.nextMoveTime = now + random(MOVE_INTERVAL_MIN, MOVE_INTERVAL_MAX + 1);
+  state.mode = NORMAL_EYE; // 初期モードは通常の目
+  state.isBlinking = false;
+  state.nextBlinkTime = now + BLINK_INTERVAL;
+  state.lookingAtCenter = true; // 初期状態はセンターを見ている
+  state.modeStartTime = now;
+  state.brightness = DISPLAY_BRIGHTNESS;
+  state.touch3Pressed = false;
+  state.touch3Released = false;
+  state.modeSequence = 0;
+  state.expression = EXPRESSION_OPEN;
+  state.prevExpression = EXPRESSION_OPEN;
+  state.expressionStartTime = now - EXPRESSION_MORPH_DURATION; // 切り替えは終わっている
+  state.nextExpressionTime = now + random(EXPRESSION_INTERVAL_MIN, EXPRESSION_INTERVAL_MAX + 1);
+}
+
+bool eyeStateUpdateMode(EyeState &state, uint32_t now)
+{
+  // 現在のモードに応じた持続時間を取得
+  uint32_t modeDuration;
+  switch (state.mode)
+  {
+  case SLOT_MACHINE:
+    modeDuration = SLOT_MACHINE_DURATION;
+    break;
+  case SLEEP_MODE:
+    modeDuration = SLEEP_MODE_DURATION;
+    break;
+  default:
+    modeDuration = NORMAL_EYE_DURATION;
+    break;
+  }
+
+  // スロットマシンとおやすみモードは時間経過で通常モードに戻る
+  EyeMode previousMode = state.mode;
+  if ((previousMode != SLOT_MACHINE && previousMode != SLEEP_MODE) || now - state.modeStartTime < modeDuration)
+  {
+    return false;
+  }
+
+  // 通常モードに戻る
+  state.mode = NORMAL_EYE;
+  state.modeStartTime = now;
+
+  // モードシーケンスを適切に進める
+  // スロットマシンモードが終わったら次の標準モード（2）に、おやすみモードが終わったら最初の標準モード（0）に
+  state.modeSequence = previousMode == SLOT_MACHINE ? 2 : 0;
+
+  // 通常モードに戻る時は明るさを元に戻す
+  state.brightness = DISPLAY_BRIGHTNESS;
+  return true;
+}
+
+bool eyeStateTouchMode(EyeState &state, bool touched, uint32_t now)
+{
+  if (touched && !state.touch3Pressed)
+  {
+    // タッチ3が押された瞬間
+    state.touch3Pressed = true;
+    state.touch3Time = now;
+  }
+  else if (!touched && state.touch3Pressed)
+  {
+    // タッチ3が離された瞬間
+    state.touch3Pressed = false;
+    state.touch3Released = true;
+  }
+
+  // タッチ3が離された後の処理
+  if (!state.touch3Released)
+  {
+    return false;
+  }
+  state.touch3Released = false;
+
+  // モードシーケンスを進める（0: 通常, 1: スロット, 2: 通常, 3: おやすみ）
+  state.modeSequence = (state.modeSequence + 1) % 4;
+
+  // シーケンスに応じてモードを設定
+  switch (state.modeSequence)
+  {
+  case 0: // 通常モード
+  case 2: // 通常モード（2回目）
+    state.mode = NORMAL_EYE;
+    break;
+  case 1: // スロットマシンモード
+    state.mode = SLOT_MACHINE;
+    state.slotState = SLOT_START;
+    state.slotStartTime = now;
+    break;
+  case 3: // おやすみモード
+    state.mode = SLEEP_MODE;
+    state.sleepState = SLEEP_START;
+    state.sleepStartTime = now;
+    break;
+  }
+
+  // モード開始時間をリセット
+  state.modeStartTime = now;
+
+  // おやすみモードで暗くなっていても、切り替えたら明るさを元に戻す（おやすみモードは自分で暗くする）
+  state.brightness = DISPLAY_BRIGHTNESS;
+  return true;
+}
+
+void eyeStateSetExpression(EyeState &state, EyeExpression expression, uint32_t now)
+{
+  state.prevExpression = state.expression;
+  state.expression = expression;
+  state.expressionStartTime = now;
+}
+
+bool eyeStateUpdateNormal(EyeState &state, uint32_t now, int maxMove)
+{
+  bool redraw = false;
+
+  // 瞬きの開始判定
+  if (!state.isBlinking && clockReached(now, state.nextBlinkTime))
+  {
+    state.isBlinking = true;
+    state.blinkStartTime = now;
+    // 瞬きの持続時間は固定で0.2秒、次の瞬きは3秒後
+    state.nextBlinkTime = now + BLINK_DURATION + BLINK_INTERVAL;
+  }
+
+  // 瞬きの終了判定（0.2秒で確実に終了）
+  if (state.isBlinking && now - state.blinkStartTime >= BLINK_DURATION)
+  {
+    state.isBlinking = false;
+    // 瞬きが終わったら再描画して元の目に戻す
+    redraw = true;
+  }
+
+  // 表情の自動切り替え判定（開いた目と、ランダムな表情を交互に）
+  if (EXPRESSION_AUTO_CYCLE && clockReached(now, state.nextExpressionTime))
+  {
+    if (state.expression == EXPRESSION_OPEN)
+    {
+      eyeStateSetExpression(state, (EyeExpression)random(EXPRESSION_HALF_CLOSED, EXPRESSION_SLEEPY + 1), now);
+    }
+    else
+    {
+      eyeStateSetExpression(state, EXPRESSION_OPEN, now);
+    }
+    state.nextExpressionTime = now + random(EXPRESSION_INTERVAL_MIN, EXPRESSION_INTERVAL_MAX + 1);
+  }
+  bool isMorphing = now - state.expressionStartTime < EXPRESSION_MORPH_DURATION;
+
+  // 動きの開始判定
+  if (!state.isMoving && clockReached(now, state.nextMoveTime))
+  {
+    state.isMoving = true;
+    state.moveStartTime = now;
+
+    // 元の位置を保存
+    state.originalLeft = state.leftEye;
+    state.originalRight = state.rightEye;
+
+    // センターを見ているかどうかで目標位置を決定
+    if (state.lookingAtCenter)
+    {
+      // センターを見ている場合は、ランダムな位置に移動
+      // 目標はピクセル単位で決め、途中の位置はサブピクセル単位で補間する
+      state.targetLeft.x = toSubpixel(random(-maxMove, maxMove + 1));
+      state.targetLeft.y = toSubpixel(random(-maxMove, maxMove + 1));
+      state.targetRight.x = state.targetLeft.x; // 両目を同じ方向に動かす
+      state.targetRight.y = state.targetLeft.y;
+
+      // 次はセンターに戻る
+      state.lookingAtCenter = false;
+    }
+    else
+    {
+      // センターを見ていない場合は、センターに戻る
+      state.targetLeft = {0, 0};
+      state.targetRight = {0, 0};
+
+      // 次はランダムな位置に移動
+      state.lookingAtCenter = true;
+    }
+
+    // 次の動きの時間を設定
+    state.nextMoveTime = now + MOVE_DURATION + MOVE_PAUSE;
+  }
+
+  // 動きの処理
+  if (state.isMoving)
+  {
+    uint32_t elapsedTime = now - state.moveStartTime;
+
+    if (elapsedTime >= MOVE_DURATION)
+    {
+      // 動きの終了
+      state.isMoving = false;
+      state.leftEye = state.targetLeft;
+      state.rightEye = state.targetRight;
+    }
+    else
+    {
+      // 動きの途中（線形補間）
+      float progress = (float)elapsedTime / MOVE_DURATION;
+
+      state.leftEye.x = state.originalLeft.x + (state.targetLeft.x - state.originalLeft.x) * progress;
+      state.leftEye.y = state.originalLeft.y + (state.targetLeft.y - state.originalLeft.y) * progress;
+
+      state.rightEye.x = state.originalRight.x + (state.targetRight.x - state.originalRight.x) * progress;
+      state.rightEye.y = state.originalRight.y + (state.targetRight.y - state.originalRight.y) * progress;
+    }
+    return true;
+  }
+
+  // 瞬き中・表情の切り替え中は常に再描画
+  return redraw || state.isBlinking || isMorphing;
+}
+
+void eyeStateAdvanceSlot(EyeState &state, uint32_t now)
+{
+  uint32_t elapsedTime = now - state.slotStartTime;
+
+  switch (state.slotState)
+  {
+  case SLOT_START:
+    // 目を下に流し終えたら回転へ
+    if (elapsedTime >= SLOT_SCROLL_DURATION)
+    {
+      state.slotState = SLOT_SPINNING;
+      state.slotStartTime = now;
+      // 回転中は回転時間を持っておく
+      state.slotNumber = SLOT_SPIN_DURATION;
+    }
+    break;
+
+  case SLOT_SPINNING:
+    if (elapsedTime >= (uint32_t)state.slotNumber)
+    {
+      // 回転終了、結果を決定
+      state.slotNumber = random(1, 21); // 01から20までのランダムな数字
+      state.slotState = SLOT_RESULT;
+      state.slotStartTime = now;
+    }
+    break;
+
+  case SLOT_RESULT:
+    // 結果表示：一定時間結果を表示
+    if (elapsedTime >= SLOT_RESULT_DURATION)
+    {
+      // 結果表示終了、終了状態へ
+      state.slotState = SLOT_END;
+      state.slotStartTime = now;
+    }
+    break;
+
+  case SLOT_END:
+    // 終了後は通常の目を中央に表示したまま待機
+    break;
+  }
+}
+
+bool eyeStateAdvanceSleep(EyeState &state, uint32_t now)
+{
+  uint32_t elapsedTime = now - state.sleepStartTime;
+
+  switch (state.sleepState)
+  {
+  case SLEEP_START:
+    // 開始状態：通常の目から開始
+    state.sleepState = SLEEP_NORMAL;
+    state.sleepStartTime = now;
+    state.brightness = DISPLAY_BRIGHTNESS; // 初期の明るさ
+    return false;
+
+  case SLEEP_NORMAL:
+    if (elapsedTime > SLEEP_NORMAL_DURATION)
+    {
+      state.sleepState = SLEEP_CLOSING;
+      state.sleepStartTime = now;
+    }
+    return false;
+
+  case SLEEP_CLOSING:
+    if (elapsedTime > SLEEP_CLOSING_DURATION)
+    {
+      state.sleepState = SLEEP_DIMMING;
+      state.sleepStartTime = now;
+    }
+    return false;
+
+  case SLEEP_DIMMING:
+    // 画面を徐々に暗くする
+    if (elapsedTime < SLEEP_DIMMING_DURATION)
+    {
+      state.brightness = DISPLAY_BRIGHTNESS - (int)((float)DISPLAY_BRIGHTNESS * elapsedTime / SLEEP_DIMMING_DURATION);
+    }
+    else
+    {
+      // 完全に暗くなったら次の状態へ
+      state.sleepState = SLEEP_COMPLETE;
+      state.sleepStartTime = now;
+      state.brightness = 0;
+    }
+    return true;
+
+  case SLEEP_COMPLETE:
+  default:
+    // 次のモード切替まで待機
+    return false;
+  }
+}
+
+bool winkerUpdate(WinkerState &winker, bool touched, uint32_t now)
+{
+  if (!touched)
+  {
+    // タッチが検出されていない場合、ウィンカーをOFFにする
+    bool changed = winker.on;
+    winker.on = false;
+    return changed;
+  }
+
+  // 点滅間隔が経過したら状態を切り替え
+  if (now - winker.lastToggleTime >= WINKER_BLINK_INTERVAL)
+  {
+    winker.on = !winker.on;
+    winker.lastToggleTime = now;
+    return true;
+  }
+  return false;
+}
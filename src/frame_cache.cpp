@@ -0,0 +1,286 @@
+// 描画状態をキーにしたフレームのキャッシュ
+#include "frame_cache.h"
+#include "memory_plan.h"
+
+constexpr size_t PARTITION_BYTES = FRAME_CACHE_BYTES / FRAME_CACHE_TARGETS;
+constexpr size_t RUN_BYTES = 4; // ラン1つのバイト数
+
+static_assert(PARTITION_BYTES <= UINT16_MAX, "cache entries use 16-bit offsets");
+
+// 登録したフレーム
+struct CacheEntry
+{
+  uint64_t key;     // 描画状態のキー
+  uint32_t lastUse; // 最後に使った時刻（LRU用の通し番号）
+  uint16_t offset;  // 領域の中の位置
+  uint16_t bytes;   // 圧縮したランの大きさ
+  DirtyRect drawn;  // 描画した範囲（論理フレーム座標）
+};
+
+// ターゲットごとの領域と表
+// エントリは領域の先頭から詰めて置き、捨てたときは後ろのエントリを詰め直す。
+struct CachePartition
+{
+  uint8_t *arena;                                // 圧縮したランを置く領域
+  size_t used;                                   // 使用中のバイト数
+  CacheEntry entries[FRAME_CACHE_ENTRIES];       // 登録中のエントリ（順不同）
+  int count;                                     // 登録中のエントリ数
+  uint32_t clock;                                // LRU用の通し番号
+  uint64_t candidates[FRAME_CACHE_CANDIDATES];   // 1回目のミスのキー（古いものから上書き）
+  int nextCandidate;                             // 次に上書きする候補
+  uint32_t lookups;
+  uint32_t hits;
+  uint32_t inserts;
+  uint32_t evictions;
+  uint32_t rejected;
+};
+
+static CachePartition partitions[FRAME_CACHE_TARGETS];
+static bool cacheReady = false;
+
+bool frameCacheBegin()
+{
+  if (cacheReady)
+  {
+    return true;
+  }
+  uint8_t *arena = (uint8_t *)memoryPlanReserve("cache", FRAME_CACHE_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (arena == nullptr)
+  {
+    return false;
+  }
+  for (int i = 0; i < FRAME_CACHE_TARGETS; i++)
+  {
+    partitions[i] = {};
+    partitions[i].arena = arena + i * PARTITION_BYTES;
+  }
+  cacheReady = true;
+  return true;
+}
+
+static int findEntry(const CachePartition &partition, uint64_t key)
+{
+  for (int i = 0; i < partition.count; i++)
+  {
+    if (partition.entries[i].key == key)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// 最も長く使っていないエントリを捨てて、後ろのエントリを詰める
+static void evictOldest(CachePartition &partition)
+{
+  int oldest = 0;
+  for (int i = 1; i < partition.count; i++)
+  {
+    if (partition.entries[i].lastUse < partition.entries[oldest].lastUse)
+    {
+      oldest = i;
+    }
+  }
+  CacheEntry removed = partition.entries[oldest];
+  size_t tail = removed.offset + removed.bytes;
+  memmove(partition.arena + removed.offset, partition.arena + tail, partition.used - tail);
+  partition.used -= removed.bytes;
+  partition.entries[oldest] = partition.entries[--partition.count];
+  for (int i = 0; i < partition.count; i++)
+  {
+    if (partition.entries[i].offset > removed.offset)
+    {
+      partition.entries[i].offset -= removed.bytes;
+    }
+  }
+  partition.evictions++;
+}
+
+// 描画した範囲のピクセルをランに圧縮する（outがnullptrならランの大きさだけを数える）
+// 範囲は行の順に1列に並べて扱い、ランは行をまたいでよい。
+static size_t encodeRuns(const RenderTarget &target, uint8_t *out)
+{
+  const DirtyRect &drawn = target.drawn;
+  if (drawn.empty())
+  {
+    return 0;
+  }
+  int stride = target.width();
+  int x0 = drawn.x0 - target.originX;
+  int y0 = drawn.y0 - target.originY;
+  int w = drawn.x1 - drawn.x0;
+  int h = drawn.y1 - drawn.y0;
+  bool bytePixels = target.sprite->getColorDepth() == 8;
+  const uint8_t *pixels8 = static_cast<const uint8_t *>(target.sprite->getBuffer());
+  const uint16_t *pixels16 = static_cast<const uint16_t *>(target.sprite->getBuffer());
+
+  size_t size = 0;
+  uint16_t runValue = 0;
+  uint16_t runCount = 0;
+  for (int y = y0; y < y0 + h; y++)
+  {
+    int row = y * stride;
+    for (int x = x0; x < x0 + w; x++)
+    {
+      uint16_t value = bytePixels ? pixels8[row + x] : pixels16[row + x];
+      if (runCount > 0 && (value != runValue || runCount == UINT16_MAX))
+      {
+        if (out != nullptr)
+        {
+          memcpy(out + size, &runCount, 2);
+          memcpy(out + size + 2, &runValue, 2);
+        }
+        size += RUN_BYTES;
+        runCount = 0;
+      }
+      runValue = value;
+      runCount++;
+    }
+  }
+  if (out != nullptr)
+  {
+    memcpy(out + size, &runCount, 2);
+    memcpy(out + size + 2, &runValue, 2);
+  }
+  return size + RUN_BYTES;
+}
+
+// ランをターゲットの描画範囲に展開する（範囲の外は黒で塗ってあるものとする）
+static void decodeRuns(RenderTarget &target, const DirtyRect &drawn, const uint8_t *runs, size_t bytes)
+{
+  int stride = target.width();
+  int x0 = drawn.x0 - target.originX;
+  int y0 = drawn.y0 - target.originY;
+  int w = drawn.x1 - drawn.x0;
+  bool bytePixels = target.sprite->getColorDepth() == 8;
+  uint8_t *pixels8 = static_cast<uint8_t *>(target.sprite->getBuffer());
+  uint16_t *pixels16 = static_cast<uint16_t *>(target.sprite->getBuffer());
+
+  int x = 0;
+  int y = 0;
+  for (size_t i = 0; i < bytes; i += RUN_BYTES)
+  {
+    uint16_t count;
+    uint16_t value;
+    memcpy(&count, runs + i, 2);
+    memcpy(&value, runs + i + 2, 2);
+    while (count > 0)
+    {
+      // 行の残りとランの短いほうをまとめて書く
+      int length = min((int)count, w - x);
+      int index = (y0 + y) * stride + x0 + x;
+      if (bytePixels)
+      {
+        memset(pixels8 + index, value, length);
+      }
+      else
+      {
+        for (int j = 0; j < length; j++)
+        {
+          pixels16[index + j] = value;
+        }
+      }
+      count -= length;
+      x += length;
+      if (x == w)
+      {
+        x = 0;
+        y++;
+      }
+    }
+  }
+}
+
+bool frameCacheLookup(int slot, uint64_t key, RenderTarget &target)
+{
+  if (!cacheReady)
+  {
+    return false;
+  }
+  CachePartition &partition = partitions[slot];
+  partition.lookups++;
+  int index = findEntry(partition, key);
+  if (index < 0)
+  {
+    return false;
+  }
+  CacheEntry &entry = partition.entries[index];
+  entry.lastUse = ++partition.clock;
+  partition.hits++;
+
+  // ラスタライズと同じく背景を黒にしてから、描画した範囲だけを展開する
+  target.fillScreen(TFT_BLACK);
+  decodeRuns(target, entry.drawn, partition.arena + entry.offset, entry.bytes);
+  target.drawn = entry.drawn;
+  return true;
+}
+
+void frameCacheStore(int slot, uint64_t key, RenderTarget &target)
+{
+  if (!cacheReady)
+  {
+    return;
+  }
+  CachePartition &partition = partitions[slot];
+  if (findEntry(partition, key) >= 0)
+  {
+    return;
+  }
+
+  // 1回目のミスは候補として覚えるだけにする
+  bool candidate = false;
+  for (int i = 0; i < FRAME_CACHE_CANDIDATES; i++)
+  {
+    if (partition.candidates[i] == key)
+    {
+      partition.candidates[i] = 0;
+      candidate = true;
+      break;
+    }
+  }
+  if (!candidate)
+  {
+    partition.candidates[partition.nextCandidate] = key;
+    partition.nextCandidate = (partition.nextCandidate + 1) % FRAME_CACHE_CANDIDATES;
+    return;
+  }
+
+  // 領域に収まらないフレームは、ほかのエントリを捨てる前にあきらめる
+  size_t bytes = encodeRuns(target, nullptr);
+  if (bytes > PARTITION_BYTES)
+  {
+    partition.rejected++;
+    return;
+  }
+  while (partition.count == FRAME_CACHE_ENTRIES || partition.used + bytes > PARTITION_BYTES)
+  {
+    evictOldest(partition);
+  }
+
+  encodeRuns(target, partition.arena + partition.used);
+  partition.entries[partition.count++] = {key, ++partition.clock, (uint16_t)partition.used, (uint16_t)bytes, target.drawn};
+  partition.used += bytes;
+  partition.inserts++;
+}
+
+FrameCacheStats frameCacheStats()
+{
+  FrameCacheStats stats = {};
+  if (!cacheReady)
+  {
+    return stats;
+  }
+  for (int i = 0; i < FRAME_CACHE_TARGETS; i++)
+  {
+    const CachePartition &partition = partitions[i];
+    stats.lookups += partition.lookups;
+    stats.hits += partition.hits;
+    stats.inserts += partition.inserts;
+    stats.evictions += partition.evictions;
+    stats.rejected += partition.rejected;
+    stats.bytes += partition.used;
+    stats.entries += partition.count;
+  }
+  stats.capacity = FRAME_CACHE_BYTES;
+  return stats;
+}
@@ -0,0 +1,232 @@
+// 描画したフレームのライブストリーム
+#include "frame_stream.h"
+#include "memory_plan.h"
+
+static uint8_t *shadow = nullptr; // ホストが持っているフレーム（1bpp、行ごとに width / 8 バイト）
+static int frameWidth = 0;
+static int frameHeight = 0;
+static int shadowStride = 0;      // 1行のバイト数
+static bool enabled = false;
+static bool needKeyframe = true;  // 次のフレームをキーフレームとして送るかどうか
+static DirtyRect lastDrawn;       // 前のフレームで描画した範囲
+static DirtyRect unsentDamage;    // 送れずに持ち越している差分領域
+static uint16_t frameIndex = 0;
+static FrameStreamStats stats;
+
+// ランレングス圧縮の出力バッファ（USB CDCへはまとめて書き込む）
+static uint8_t outBuffer[256];
+static size_t outLength = 0;
+static bool writeFailed = false;
+
+static void flushOut()
+{
+  if (outLength == 0)
+  {
+    return;
+  }
+  if (Serial.write(outBuffer, outLength) != outLength)
+  {
+    writeFailed = true;
+  }
+  stats.bytes += outLength;
+  outLength = 0;
+}
+
+static void putByte(uint8_t value)
+{
+  if (outLength == sizeof(outBuffer))
+  {
+    flushOut();
+  }
+  outBuffer[outLength++] = value;
+}
+
+static void putWord(uint16_t value)
+{
+  putByte(value & 0xFF);
+  putByte(value >> 8);
+}
+
+// ランレングス圧縮の状態
+static uint8_t runValue = 0;
+static uint8_t runCount = 0;
+
+static void putRun(uint8_t value)
+{
+  if (runCount > 0 && (runValue != value || runCount == 255))
+  {
+    putByte(runCount);
+    putByte(runValue);
+    runCount = 0;
+  }
+  runValue = value;
+  runCount++;
+}
+
+static void endRun()
+{
+  if (runCount > 0)
+  {
+    putByte(runCount);
+    putByte(runValue);
+    runCount = 0;
+  }
+}
+
+// スプライトの8ピクセルを輝度で2値化して1バイトにする
+static uint8_t packPixels(LGFX_Sprite *sprite, int x, int y)
+{
+  uint8_t bits = 0;
+  if (sprite->getColorDepth() == 8)
+  {
+    // RGB332：緑の上位ビットで判定
+    const uint8_t *row = (const uint8_t *)sprite->getBuffer() + y * sprite->width() + x;
+    for (int i = 0; i < 8; i++)
+    {
+      bits = (bits << 1) | ((row[i] >> 4) & 1);
+    }
+  }
+  else
+  {
+    // RGB565（上位バイトが先）：緑の上位ビットで判定
+    const uint8_t *row = (const uint8_t *)sprite->getBuffer() + (y * sprite->width() + x) * 2;
+    for (int i = 0; i < 8; i++)
+    {
+      bits = (bits << 1) | ((row[i * 2] >> 2) & 1);
+    }
+  }
+  return bits;
+}
+
+bool frameStreamBegin(int width, int height)
+{
+  frameWidth = width;
+  frameHeight = height;
+  shadowStride = (width + 7) / 8;
+  if (shadow == nullptr)
+  {
+    shadow = (uint8_t *)memoryPlanReserve("stream", shadowStride * height, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  return shadow != nullptr;
+}
+
+void frameStreamSetEnabled(bool enable)
+{
+  enabled = enable && shadow != nullptr;
+  needKeyframe = true;
+}
+
+bool frameStreamEnabled()
+{
+  return enabled;
+}
+
+void frameStreamSubmit(RenderTarget *targets, int count)
+{
+  // 今回の描画範囲（ターゲットの合計）
+  DirtyRect drawn = {};
+  for (int i = 0; i < count; i++)
+  {
+    drawn.merge(targets[i].drawn);
+  }
+
+  if (!enabled)
+  {
+    lastDrawn = drawn;
+    return;
+  }
+
+  // 背景は常に黒なので、変化しうるのは前回と今回の描画範囲だけ
+  DirtyRect damage = unsentDamage;
+  damage.merge(lastDrawn);
+  damage.merge(drawn);
+  lastDrawn = drawn;
+
+  bool keyframe = needKeyframe;
+  if (keyframe)
+  {
+    memset(shadow, 0, shadowStride * frameHeight);
+    damage = {0, 0, frameWidth, frameHeight};
+  }
+  if (damage.empty())
+  {
+    return;
+  }
+
+  // 送信バッファに空きがなければ、差分を持ち越して次のフレームで送る
+  if (Serial.availableForWrite() < 64)
+  {
+    unsentDamage = damage;
+    stats.skipped++;
+    return;
+  }
+
+  unsigned long start = micros();
+
+  // ターゲットごとに差分領域を8ピクセル単位に揃えて切り出す
+  DirtyRect rects[STREAM_MAX_RECTS];
+  RenderTarget *rectTargets[STREAM_MAX_RECTS];
+  int rectCount = 0;
+  for (int i = 0; i < count && rectCount < STREAM_MAX_RECTS; i++)
+  {
+    DirtyRect rect = damage;
+    rect.x0 &= ~7;
+    rect.x1 = (rect.x1 + 7) & ~7;
+    rect.intersect(targets[i].originX, targets[i].originY, targets[i].width(), targets[i].height());
+    if (!rect.empty())
+    {
+      rects[rectCount] = rect;
+      rectTargets[rectCount++] = &targets[i];
+    }
+  }
+
+  writeFailed = false;
+  putByte(STREAM_SYNC0);
+  putByte(STREAM_SYNC1);
+  putByte(keyframe ? STREAM_FLAG_KEYFRAME : 0);
+  putByte(rectCount);
+  putWord(frameIndex++);
+  putWord(frameWidth);
+  putWord(frameHeight);
+
+  for (int r = 0; r < rectCount; r++)
+  {
+    const DirtyRect &rect = rects[r];
+    RenderTarget *target = rectTargets[r];
+    putWord(rect.x0);
+    putWord(rect.y0);
+    putWord(rect.x1 - rect.x0);
+    putWord(rect.y1 - rect.y0);
+
+    // 前回フレームとのXOR差分を行ごとに取り出してランレングス圧縮
+    for (int y = rect.y0; y < rect.y1; y++)
+    {
+      uint8_t *shadowRow = shadow + y * shadowStride;
+      for (int x = rect.x0; x < rect.x1; x += 8)
+      {
+        uint8_t bits = packPixels(target->sprite, x - target->originX, y - target->originY);
+        putRun(bits ^ shadowRow[x / 8]);
+        shadowRow[x / 8] = bits;
+      }
+    }
+    endRun();
+  }
+  flushOut();
+
+  // 途中で書き込めなかった場合はホストと食い違うので、次はキーフレームを送る
+  needKeyframe = writeFailed;
+  unsentDamage.clear();
+
+  uint32_t elapsed = micros() - start;
+  stats.frames++;
+  stats.encodeMicros += elapsed;
+  if (elapsed > stats.maxMicros)
+  {
+    stats.maxMicros = elapsed;
+  }
+}
+
+const FrameStreamStats &frameStreamStats()
+{
+  return stats;
+}
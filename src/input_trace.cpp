@@ -0,0 +1,215 @@
+// 入力トレースの記録と再生
+#include "input_trace.h"
+
+// 仮想クロックの状態
+static bool virtualClockEnabled = false;  // 仮想クロックが有効かどうか
+static unsigned long virtualClockNow = 0; // 仮想クロックの現在時刻
+
+// トレースの状態
+static TraceRecord traceRing[TRACE_CAPACITY]; // レコードのリングバッファ
+static TraceHeader header;                    // 現在のヘッダ
+static size_t ringHead = 0;                   // 最も古いレコードの位置
+static bool recording = false;                // 記録中かどうか
+static bool touchLevels[TRACE_TOUCH_COUNT];   // 最後に記録したタッチのレベル
+
+// 再生の状態
+static bool replaying = false;                 // 再生中かどうか
+static bool injectedLevels[TRACE_TOUCH_COUNT]; // 再生中に注入しているタッチのレベル
+static size_t replayModeCursor = 0;            // 次に照合するモード遷移レコードの位置
+static uint32_t replayDivergences = 0;         // 記録と一致しなかったモード遷移の数
+static uint32_t replayTolerance = 0;           // モード遷移の時刻の許容差（ミリ秒）
+
+unsigned long clockMillis()
+{
+  return virtualClockEnabled ? virtualClockNow : millis();
+}
+
+void clockUseVirtual(unsigned long startTime)
+{
+  virtualClockEnabled = true;
+  virtualClockNow = startTime;
+}
+
+void clockAdvanceTo(unsigned long time)
+{
+  virtualClockNow = time;
+}
+
+void clockUseReal()
+{
+  virtualClockEnabled = false;
+}
+
+bool clockIsVirtual()
+{
+  return virtualClockEnabled;
+}
+
+// レコードを追加する（満杯の場合は最も古いレコードを上書き）
+static void pushRecord(uint8_t type, uint8_t arg, uint16_t value)
+{
+  TraceRecord &record = traceRing[(ringHead + header.count) % TRACE_CAPACITY];
+  record.time = clockMillis();
+  record.type = type;
+  record.arg = arg;
+  record.value = value;
+
+  if (header.count < TRACE_CAPACITY)
+  {
+    header.count++;
+  }
+  else
+  {
+    ringHead = (ringHead + 1) % TRACE_CAPACITY;
+    header.dropped++;
+  }
+}
+
+void traceBegin(uint32_t seed, unsigned long startTime)
+{
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.recordSize = sizeof(TraceRecord);
+  header.seed = seed;
+  header.startTime = startTime;
+  header.count = 0;
+  header.dropped = 0;
+  ringHead = 0;
+  for (int i = 0; i < TRACE_TOUCH_COUNT; i++)
+  {
+    touchLevels[i] = false;
+  }
+  recording = true;
+}
+
+bool traceTouch(int index, bool level)
+{
+  if (replaying)
+  {
+    // 再生中は実際のピンではなく注入されたレベルを返す
+    return injectedLevels[index];
+  }
+
+  if (recording && touchLevels[index] != level)
+  {
+    pushRecord(TRACE_TOUCH_EDGE, index, level ? 1 : 0);
+    touchLevels[index] = level;
+  }
+  return level;
+}
+
+void traceModeChange(uint8_t mode, uint8_t sequence)
+{
+  if (!replaying)
+  {
+    if (recording)
+    {
+      pushRecord(TRACE_MODE_CHANGE, mode, sequence);
+    }
+    return;
+  }
+
+  // 再生中は記録されたモード遷移と順番に照合する（時刻は許容差の範囲なら一致とみなす）
+  while (replayModeCursor < header.count && traceAt(replayModeCursor).type != TRACE_MODE_CHANGE)
+  {
+    replayModeCursor++;
+  }
+  if (replayModeCursor >= header.count)
+  {
+    replayDivergences++; // 記録にない遷移
+    return;
+  }
+
+  const TraceRecord &expected = traceAt(replayModeCursor++);
+  int32_t drift = (int32_t)(clockMillis() - expected.time);
+  if (expected.arg != mode || expected.value != sequence || (uint32_t)abs(drift) > replayTolerance)
+  {
+    replayDivergences++;
+  }
+}
+
+const TraceHeader &traceHeader()
+{
+  return header;
+}
+
+size_t traceCount()
+{
+  return header.count;
+}
+
+const TraceRecord &traceAt(size_t index)
+{
+  return traceRing[(ringHead + index) % TRACE_CAPACITY];
+}
+
+void traceDump(Print &out)
+{
+  out.write((const uint8_t *)&header, sizeof(header));
+  for (size_t i = 0; i < header.count; i++)
+  {
+    out.write((const uint8_t *)&traceAt(i), sizeof(TraceRecord));
+  }
+}
+
+bool traceLoad(Stream &in)
+{
+  TraceHeader loaded;
+  if (in.readBytes((uint8_t *)&loaded, sizeof(loaded)) != sizeof(loaded))
+  {
+    return false;
+  }
+  if (loaded.magic != TRACE_MAGIC || loaded.version != TRACE_VERSION ||
+      loaded.recordSize != sizeof(TraceRecord) || loaded.count > TRACE_CAPACITY)
+  {
+    return false;
+  }
+
+  // 読み込み中に記録が混ざらないよう記録を止める
+  recording = false;
+  ringHead = 0;
+  if (in.readBytes((uint8_t *)traceRing, loaded.count * sizeof(TraceRecord)) != loaded.count * sizeof(TraceRecord))
+  {
+    header.count = 0;
+    return false;
+  }
+  header = loaded;
+  return true;
+}
+
+void traceReplayBegin(uint32_t tolerance)
+{
+  recording = false;
+  replaying = true;
+  replayModeCursor = 0;
+  replayTolerance = tolerance;
+  replayDivergences = 0;
+  for (int i = 0; i < TRACE_TOUCH_COUNT; i++)
+  {
+    injectedLevels[i] = false;
+  }
+  clockUseVirtual(header.startTime);
+}
+
+void traceReplayInject(const TraceRecord &record)
+{
+  if (record.type == TRACE_TOUCH_EDGE && record.arg < TRACE_TOUCH_COUNT)
+  {
+    injectedLevels[record.arg] = record.value != 0;
+  }
+}
+
+uint32_t traceReplayEnd()
+{
+  // 記録されていたのに再現されなかったモード遷移も不一致として数える
+  for (; replayModeCursor < header.count; replayModeCursor++)
+  {
+    if (traceAt(replayModeCursor).type == TRACE_MODE_CHANGE)
+    {
+      replayDivergences++;
+    }
+  }
+  replaying = false;
+  clockUseReal();
+  return replayDivergences;
+}
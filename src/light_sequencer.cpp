@@ -0,0 +1,191 @@
+// LEDテープのパターンシーケンサー
+#include "light_sequencer.h"
+#include <driver/rmt.h>
+
+// WS2812のタイミング（RMTのクロック80MHzを2分周して1tick = 25ns）
+constexpr uint8_t RMT_CLOCK_DIVIDER = 2;
+constexpr uint16_t WS2812_T0H = 16;     // 0ビットのHIGH時間（0.4us）
+constexpr uint16_t WS2812_T0L = 34;     // 0ビットのLOW時間（0.85us）
+constexpr uint16_t WS2812_T1H = 32;     // 1ビットのHIGH時間（0.8us）
+constexpr uint16_t WS2812_T1L = 18;     // 1ビットのLOW時間（0.45us）
+constexpr uint16_t WS2812_RESET = 2400; // リセット（60us）
+constexpr int LIGHT_ITEM_COUNT = LIGHT_STRIP_LENGTH * 24 + 1; // 1本分のRMT送信データ（1ビット1アイテム＋リセット）
+
+// パターンの1ステップ
+struct LightStep
+{
+  uint16_t duration; // ステップの長さ（ミリ秒、0なら最後まで保持）
+  uint8_t lit;       // 先頭から点灯する長さ（テープ全体を8とする）
+  uint8_t level;     // 明るさ（0-255）
+};
+
+// パターンの定義
+struct LightPatternDef
+{
+  const LightStep *steps; // ステップの並び
+  uint8_t stepCount;      // ステップ数
+  bool loop;              // 最後まで進んだら先頭に戻るか（falseなら最後のステップを保持）
+};
+
+constexpr LightStep STEPS_OFF[] = {{0, 0, 0}};
+// 内側から外側へ流れて点灯し、消灯する（1周期1000ms）
+constexpr LightStep STEPS_TURN_SEQUENTIAL[] = {
+    {40, 1, 255}, {40, 2, 255}, {40, 3, 255}, {40, 4, 255}, {40, 5, 255}, {40, 6, 255}, {40, 7, 255}, {220, 8, 255}, {460, 0, 0}};
+// 全体を500msごとに点滅（従来のウィンカーと同じ間隔）
+constexpr LightStep STEPS_HAZARD[] = {{500, 8, 255}, {500, 0, 0}};
+// 3回すばやく点滅してから点灯し続ける
+constexpr LightStep STEPS_BRAKE_FLASH[] = {
+    {80, 8, 255}, {80, 0, 0}, {80, 8, 255}, {80, 0, 0}, {80, 8, 255}, {80, 0, 0}, {0, 8, 255}};
+// 明るさを段階的に上げてから点灯し続ける
+constexpr LightStep STEPS_HEADLIGHT_FADEIN[] = {
+    {60, 8, 8}, {60, 8, 16}, {60, 8, 32}, {60, 8, 64}, {60, 8, 96}, {60, 8, 144}, {60, 8, 200}, {0, 8, 255}};
+
+#define LIGHT_PATTERN(steps, loop) {steps, sizeof(steps) / sizeof(steps[0]), loop}
+const LightPatternDef patternTable[LIGHT_PATTERN_COUNT] = {
+    LIGHT_PATTERN(STEPS_OFF, false),              // PATTERN_OFF
+    LIGHT_PATTERN(STEPS_TURN_SEQUENTIAL, true),   // PATTERN_TURN_SEQUENTIAL
+    LIGHT_PATTERN(STEPS_HAZARD, true),            // PATTERN_HAZARD
+    LIGHT_PATTERN(STEPS_BRAKE_FLASH, false),      // PATTERN_BRAKE_FLASH
+    LIGHT_PATTERN(STEPS_HEADLIGHT_FADEIN, false), // PATTERN_HEADLIGHT_FADEIN
+};
+#undef LIGHT_PATTERN
+
+// 系統ごとの色（R, G, B）
+const uint8_t channelColors[LIGHT_CHANNEL_COUNT][3] = {
+    {255, 100, 0},   // 右ウィンカー（アンバー）
+    {255, 100, 0},   // 左ウィンカー（アンバー）
+    {255, 255, 255}, // ヘッドライト（白）
+    {255, 0, 0},     // ブレーキライト（赤）
+};
+
+// 系統ごとの状態
+struct LightChannelState
+{
+  LightPattern pattern;                 // 現在のパターン
+  uint8_t step;                         // 現在のステップ
+  unsigned long stepStartTime;          // ステップの開始時間
+  int shownLit;                         // 送信済みの点灯数（-1: 未送信）
+  int shownLevel;                       // 送信済みの明るさ
+  rmt_item32_t items[LIGHT_ITEM_COUNT]; // RMT送信データ（送信中は書き換えない）
+};
+
+static LightChannelState channels[LIGHT_CHANNEL_COUNT];
+static bool lightsReady = false;
+
+bool lightSequencerBegin(const int pins[LIGHT_CHANNEL_COUNT])
+{
+  for (int i = 0; i < LIGHT_CHANNEL_COUNT; i++)
+  {
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pins[i], (rmt_channel_t)i);
+    config.clk_div = RMT_CLOCK_DIVIDER;
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install((rmt_channel_t)i, 0, 0) != ESP_OK)
+    {
+      return false;
+    }
+    channels[i].pattern = PATTERN_OFF;
+    channels[i].step = 0;
+    channels[i].stepStartTime = 0;
+    channels[i].shownLit = -1;
+    channels[i].shownLevel = -1;
+  }
+  lightsReady = true;
+  return true;
+}
+
+void lightSetPattern(LightChannel channel, LightPattern pattern, unsigned long currentTime)
+{
+  LightChannelState &state = channels[channel];
+  if (state.pattern == pattern)
+  {
+    return;
+  }
+  state.pattern = pattern;
+  state.step = 0;
+  state.stepStartTime = currentTime;
+}
+
+// 1バイトを8個のRMTアイテムに変換する（上位ビットから）
+static rmt_item32_t *encodeByte(rmt_item32_t *item, uint8_t value)
+{
+  for (int bit = 7; bit >= 0; bit--, item++)
+  {
+    bool one = (value >> bit) & 1;
+    item->level0 = 1;
+    item->duration0 = one ? WS2812_T1H : WS2812_T0H;
+    item->level1 = 0;
+    item->duration1 = one ? WS2812_T1L : WS2812_T0L;
+  }
+  return item;
+}
+
+// 点灯内容をRMT送信データに変換する
+static void encodeChannel(int channel, int lit, int level)
+{
+  const uint8_t *color = channelColors[channel];
+  uint8_t r = color[0] * level / 255;
+  uint8_t g = color[1] * level / 255;
+  uint8_t b = color[2] * level / 255;
+  int litLeds = (lit * LIGHT_STRIP_LENGTH + 7) / 8;
+
+  rmt_item32_t *item = channels[channel].items;
+  for (int led = 0; led < LIGHT_STRIP_LENGTH; led++)
+  {
+    bool on = led < litLeds;
+    // WS2812はGRBの順に送る
+    item = encodeByte(item, on ? g : 0);
+    item = encodeByte(item, on ? r : 0);
+    item = encodeByte(item, on ? b : 0);
+  }
+  item->level0 = 0;
+  item->duration0 = WS2812_RESET;
+  item->level1 = 0;
+  item->duration1 = 0;
+}
+
+void lightUpdate(unsigned long currentTime)
+{
+  if (!lightsReady)
+  {
+    return;
+  }
+
+  for (int i = 0; i < LIGHT_CHANNEL_COUNT; i++)
+  {
+    LightChannelState &state = channels[i];
+    const LightPatternDef &pattern = patternTable[state.pattern];
+
+    // 経過時間に応じてステップを進める
+    while (pattern.steps[state.step].duration != 0 &&
+           currentTime - state.stepStartTime >= pattern.steps[state.step].duration)
+    {
+      state.stepStartTime += pattern.steps[state.step].duration;
+      if (state.step + 1 < pattern.stepCount)
+      {
+        state.step++;
+      }
+      else if (pattern.loop)
+      {
+        state.step = 0;
+      }
+      else
+      {
+        break;
+      }
+    }
+
+    // 表示内容が変わったときだけ、前の送信が終わっていれば送信データを作り直して送る
+    const LightStep &step = pattern.steps[state.step];
+    if (step.lit == state.shownLit && step.level == state.shownLevel)
+    {
+      continue;
+    }
+    if (rmt_wait_tx_done((rmt_channel_t)i, 0) != ESP_OK)
+    {
+      continue; // 送信中なので次の更新で送る
+    }
+    encodeChannel(i, step.lit, step.level);
+    rmt_write_items((rmt_channel_t)i, state.items, LIGHT_ITEM_COUNT, false);
+    state.shownLit = step.lit;
+    state.shownLevel = step.level;
+  }
+}
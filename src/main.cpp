@@ -5,17 +5,24 @@
 
 // ST7789のみ使うならM5GFX.hでもよい
 #include <M5Unified.h>
-#include <lgfx/v1/panel/Panel_ST7789.hpp>
-
-// 使用したピン
+#include "panel_profile.h"
+#include "input_trace.h"
+#include "raster_worker.h"
+#include "render_target.h"
+#include "eye_state.h"
+#include "eye_set.h"
+#include "eye_coverage.h"
+#include "eye_expression.h"
+#include "frame_stream.h"
+#include "frame_cache.h"
+#include "overdraw_profiler.h"
+#include "transition.h"
+#include "light_sequencer.h"
+#include "memory_plan.h"
+
+// 使用したピン（ディスプレイのピンはpanel_profile.hのプロファイルを参照）
 // 3.3V -> VCC
 // G    -> GND
-constexpr int PIN_SCL = 1;       // SCLK(SPI Clock) (SCL)
-constexpr int PIN_SDA = 3;       // MOSI (SDA)
-constexpr int PIN_RST = 5;       // Reset
-constexpr int PIN_DC = 7;        // Data/Command
-constexpr int PIN_BLK = 44;      // Backlight
-constexpr int PIN_CS = 43;       // Chip Select
 constexpr int PIN_WINKER_R = 9;  // ウィンカー右
 constexpr int PIN_WINKER_L = 11; // ウィンカー左
 constexpr int PIN_TOUCH1 = 12;   // タッチ1
@@ -25,104 +32,63 @@ constexpr int PIN_TOUCH4 = 40;   // タッチ4
 constexpr int PIN_HEAD = 14;     // ヘッドライト
 constexpr int PIN_BRAKE = 41;    // ブレーキライト
 
-// 目の設定
-constexpr int EYE_RADIUS = 50;                       // 目の半径
-constexpr int EYE_SPACING = 190;                     // 目の間隔
-constexpr int PUPIL_RADIUS = 25;                     // 瞳の半径
-constexpr int SQUARE_EYE_WIDTH = 60;                 // 四角い目の幅
-constexpr int SQUARE_EYE_HEIGHT = 120;               // 四角い目の高さ
-constexpr int SQUARE_EYE_RADIUS = 5;                 // 四角い目の角の丸み
-constexpr int DISPLAY_WIDTH = 320;                   // ディスプレイの幅
-constexpr int DISPLAY_HEIGHT = 240;                  // ディスプレイの高さ
-constexpr int DISPLAY_CENTER_X = DISPLAY_WIDTH / 2;  // ディスプレイの中心X
-constexpr int DISPLAY_CENTER_Y = DISPLAY_HEIGHT / 2; // ディスプレイの中心Y
-constexpr int MOVE_INTERVAL_MIN = 2000;              // 目の動きの最小間隔（ミリ秒）
-constexpr int MOVE_INTERVAL_MAX = 5000;              // 目の動きの最大間隔（ミリ秒）
-constexpr int MOVE_DURATION = 200;                   // 目の動きの持続時間（ミリ秒）
-constexpr int BLINK_INTERVAL = 3100;                 // 瞬きの間隔（ミリ秒）
-constexpr int BLINK_DURATION = 200;                  // 瞬きの持続時間（ミリ秒）
+// 目の設定（寸法はpanel_profile.hのプロファイル、動き・瞬き・表情・モードの時間はeye_state.hを参照）
+constexpr int EYE_RADIUS = 50;   // 目の半径
+constexpr int PUPIL_RADIUS = 25; // 瞳の半径
 
 // 色の設定
 // ライブラリの定義済み色定数を使用
 constexpr uint32_t SQUARE_EYE_COLOR = TFT_WHITE; // 白色
 
-// モード切替の定数
-constexpr int NORMAL_EYE_DURATION = 9000;    // 通常の目モードの持続時間（ミリ秒）
-constexpr int SLOT_MACHINE_DURATION = 10000; // スロットマシンモードの持続時間（ミリ秒）
-constexpr int SLEEP_MODE_DURATION = 10000;   // おやすみモードの持続時間（ミリ秒）
+// 目の輪郭をアンチエイリアスし、サブピクセル単位の位置に描くかどうか
+// （falseなら従来どおりfillRoundRectでピクセル単位に描く）
+constexpr bool EYE_ANTIALIAS = true;
 
-// 目のモード
-enum EyeMode
-{
-  NORMAL_EYE = 0,   // 通常の目（四角い目）
-  SLOT_MACHINE = 1, // スロットマシンモード
-  SLEEP_MODE = 2,   // おやすみモード
-  EYE_MODE_COUNT    // モードの数
-};
+// 描画状態が同じフレームをラスタライズせずにキャッシュから展開するかどうか
+constexpr bool FRAME_CACHE_ENABLED = true;
 
-// スロットマシンの状態
-enum SlotState
-{
-  SLOT_START,    // 開始状態
-  SLOT_SPINNING, // 回転中
-  SLOT_RESULT,   // 結果表示中
-  SLOT_END       // 終了状態
-};
+// モードを切り替えるときに前後のフレームを混ぜる時間（ミリ秒）（0なら従来どおりすぐに切り替える）
+constexpr int MODE_TRANSITION_DURATION = 400;
 
-// おやすみモードの状態
-enum SleepState
-{
-  SLEEP_START,   // 開始状態
-  SLEEP_NORMAL,  // 通常の目を表示
-  SLEEP_CLOSING, // 目を閉じている途中
-  SLEEP_DIMMING, // 画面を暗くしている途中
-  SLEEP_COMPLETE // 完全に暗くなった状態
-};
+// 目のセットの並べ方
+// 論理フレームを横EYE_SET_COLUMNS×縦EYE_SET_ROWSのタイルに分け、タイルごとに独立した1組の目を描く
+// （1×1なら従来どおり画面全体に1組、パネル2枚のプロファイルは1×1のみ）
+constexpr int EYE_SET_COLUMNS = 1;
+constexpr int EYE_SET_ROWS = 1;
+constexpr int EYE_SET_COUNT = EYE_SET_COLUMNS * EYE_SET_ROWS;
+constexpr int EYE_SET_TOUCH = 2; // 目のセットのモードを切り替えるタッチの番号（タッチ3、すべてのセットで共通）
+
+// 目のセット1組分のレイアウト（タイルの大きさ）
+template <typename Panel>
+using SetLayoutOf = EyeLayout<PanelTiles<Panel, EYE_SET_COLUMNS, EYE_SET_ROWS>>;
+using SetLayout = SetLayoutOf<ActivePanel>;
+
+static_assert(ActivePanel::PANEL_COUNT == 1 || EYE_SET_COUNT == 1, "the eye windows of the dual panel profile hold one eye set");
 
-// 目の位置情報
-struct EyePosition
+// レンダリング方式
+enum RenderMode
 {
-  int x;
-  int y;
+  RENDER_SINGLE_CORE,      // 1コアでフレーム全体を描く
+  RENDER_SPLIT_LEFT_RIGHT, // 左右のタイルに分け、2コアで同時に描く
+  RENDER_SPLIT_TOP_BOTTOM, // 上下のタイルに分け、2コアで同時に描く
+  RENDER_ALTERNATE_FRAMES  // 2コアが交互にラスタライズと転送を受け持つ（1フレーム遅延）
 };
+constexpr RenderMode RENDER_MODE = RENDER_SPLIT_LEFT_RIGHT;
 
-// 目の状態
-struct EyeState
-{
-  EyePosition leftEye;          // 現在の左目の位置
-  EyePosition rightEye;         // 現在の右目の位置
-  EyePosition prevLeftEye;      // 前回の左目の位置
-  EyePosition prevRightEye;     // 前回の右目の位置
-  unsigned long nextMoveTime;   // 次の動きの時間
-  bool isMoving;                // 動き中フラグ
-  unsigned long moveStartTime;  // 動きの開始時間
-  EyePosition targetLeft;       // 目標の左目位置
-  EyePosition targetRight;      // 目標の右目位置
-  EyePosition originalLeft;     // 動き開始時の左目位置
-  EyePosition originalRight;    // 動き開始時の右目位置
-  bool initialized;             // 初期化済みフラグ
-  EyeMode mode;                 // 目のモード
-  unsigned long nextBlinkTime;  // 次の瞬きの時間
-  bool isBlinking;              // 瞬き中フラグ
-  unsigned long blinkStartTime; // 瞬きの開始時間
-  bool lookingAtCenter;         // センターを見ているかどうか
-  unsigned long modeStartTime;  // モード開始時間
-  SlotState slotState;          // スロットマシンの状態
-  unsigned long slotStartTime;  // スロット開始時間
-  int slotNumber;               // スロットの結果の数字
-  SleepState sleepState;        // おやすみモードの状態
-  unsigned long sleepStartTime; // おやすみモード開始時間
-  int brightness;               // 画面の明るさ（おやすみモード用）
-  bool touch3Pressed;           // タッチ3が押されたかどうか
-  bool touch3Released;          // タッチ3が離されたかどうか
-  unsigned long touch3Time;     // タッチ3が最後に押された時間
-  int modeSequence;             // モード切り替えのシーケンス（0: 通常, 1: スロット, 2: 通常, 3: おやすみ）
-};
+// トレース再生の定数
+constexpr int REPLAY_FRAME_INTERVAL = 17; // 再生時の1フレームの仮想時間（ミリ秒）（delay(16)＋処理時間相当）
+
+// ウィンカーの状態
+WinkerState winkerState = {};
 
-// ウィンカー制御用の変数
-unsigned long lastWinkerToggleTime = 0;    // 最後にウィンカーの状態を切り替えた時間
-bool winkerState = false;                  // ウィンカーの現在の状態
-constexpr int WINKER_BLINK_INTERVAL = 500; // ウィンカー点滅間隔（ミリ秒）
+// ライトの出力方式
+enum LightOutput
+{
+  LIGHT_OUTPUT_GPIO,  // 各ピンをdigitalWriteでON/OFFする
+  LIGHT_OUTPUT_STRIP, // 各ピンにLEDテープをつなぎ、RMTでパターンを流す
+};
+constexpr LightOutput LIGHT_OUTPUT = LIGHT_OUTPUT_GPIO;
+constexpr LightPattern WINKER_PATTERN = PATTERN_TURN_SEQUENTIAL; // LEDテープでのウィンカーのパターン
 
 // ヘッドライト制御用の変数
 bool headlightState = true;   // ヘッドライトの現在の状態（初期状態はON）
@@ -131,14 +97,16 @@ bool prevTouch2State = false; // 前回のタッチ2の状態
 // LovyanGFX: https://github.com/lovyan03/LovyanGFX
 // LovyanGFXのHowToUse/2_user_setting/2_user_setting.inoのコードより
 // https://github.com/lovyan03/LovyanGFX/blob/3608914/examples/HowToUse/2_user_setting/2_user_setting.ino
-class LGFX_AtomS3_SPI_ST7789 : public lgfx::LGFX_Device
+// パネルのプロファイル（ピン・解像度・回転）を型引数にとる
+template <typename Panel>
+class LGFX_AtomS3_SPI : public lgfx::LGFX_Device
 {
-  lgfx::Panel_ST7789 _panel_instance; // 接続するパネルの型にあったインスタンスを用意
-  lgfx::Bus_SPI _bus_instance;        // パネルを接続するバスの種類にあったインスタンスを用意
-  lgfx::Light_PWM _light_instance;    // バックライト制御が可能な場合はインスタンスを用意(必要なければ削除)
+  typename Panel::PanelDriver _panel_instance; // 接続するパネルの型にあったインスタンスを用意
+  lgfx::Bus_SPI _bus_instance;                 // パネルを接続するバスの種類にあったインスタンスを用意
+  lgfx::Light_PWM _light_instance;             // バックライト制御が可能な場合はインスタンスを用意(必要なければ削除)
 
 public:
-  LGFX_AtomS3_SPI_ST7789(void)
+  LGFX_AtomS3_SPI(void)
   {
     {                                    // バス制御の設定を行います。
       auto cfg = _bus_instance.config(); // バス設定用の構造体を取得
@@ -149,292 +117,1182 @@ public:
       // ※ ESP-IDFバージョンアップに伴い、VSPI_HOST , HSPI_HOSTの記述は非推奨になるため、
       // エラーが出る場合は代わりにSPI2_HOST , SPI3_HOSTを使用してください。
       cfg.spi_host = SPI2_HOST;
-      cfg.spi_mode = 3;       // SPI通信モードを設定(0-3)
-      cfg.pin_sclk = PIN_SCL; // SPIのSCLK(SCL)ピン番号を設定
-      cfg.pin_mosi = PIN_SDA; // SPIのMOSI(SDA)ピン番号を設定
-      cfg.pin_miso = -1;      // SPIのMISOピン番号を設定 (-1 = disable)
-      cfg.pin_dc = PIN_DC;    // SPIのD/C(Data/Command)ピン番号を設定 (-1 = disable)
+      cfg.spi_mode = 3;              // SPI通信モードを設定(0-3)
+      cfg.pin_sclk = Panel::PIN_SCL; // SPIのSCLK(SCL)ピン番号を設定
+      cfg.pin_mosi = Panel::PIN_SDA; // SPIのMOSI(SDA)ピン番号を設定
+      cfg.pin_miso = -1;             // SPIのMISOピン番号を設定 (-1 = disable)
+      cfg.pin_dc = Panel::PIN_DC;    // SPIのD/C(Data/Command)ピン番号を設定 (-1 = disable)
       // SDカードと共通のSPIバスを使う場合、MISOは省略せず必ず設定してください。
-      _bus_instance.config(cfg);              // 設定値をバスに反映します。
-      _panel_instance.setBus(&_bus_instance); // バスをパネルにセットします。
+      _bus_instance.config(cfg); // 設定値をバスに反映します。
     }
 
-    {                                      // 表示パネル制御の設定を行います。
-      auto cfg = _panel_instance.config(); // 表示パネル設定用の構造体を取得
-      cfg.pin_cs = PIN_CS;                 // CSが接続されているピン番号   (-1 = disable)
-      cfg.pin_rst = PIN_RST;               // RSTが接続されているピン番号  (-1 = disable)
-      cfg.pin_busy = -1;                   // BUSYが接続されているピン番号 (-1 = disable)
-      cfg.panel_width = 240;               // 実際に表示可能な幅
-      cfg.panel_height = 320;              // 実際に表示可能な高さ
-      cfg.invert = true;                   // パネルの明暗が反転してしまう場合 trueに設定
-      cfg.offset_rotation = 3;
-      _panel_instance.config(cfg);
-    }
+    configurePanel(&_bus_instance, Panel::PIN_CS, Panel::PIN_RST);
 
     {                                      // バックライト制御の設定を行います。（必要なければ削除）
       auto cfg = _light_instance.config(); // バックライト設定用の構造体を取得
-      cfg.pin_bl = PIN_BLK;                // バックライトが接続されているピン番号
+      cfg.pin_bl = Panel::PIN_BLK;         // バックライトが接続されているピン番号
       _light_instance.config(cfg);
       _panel_instance.setLight(&_light_instance); // バックライトをパネルにセット
     }
 
     setPanel(&_panel_instance); // 使用するパネルをセット
   }
+
+  // 同じSPIバスにつないだ2枚目のパネル（CSだけが異なり、リセットとバックライトは1枚目が受け持つ）
+  LGFX_AtomS3_SPI(LGFX_AtomS3_SPI &primary, int pinCs)
+  {
+    configurePanel(&primary._bus_instance, pinCs, -1);
+    setPanel(&_panel_instance);
+  }
+
+private:
+  void configurePanel(lgfx::Bus_SPI *bus, int pinCs, int pinRst)
+  {
+    _panel_instance.setBus(bus);             // バスをパネルにセットします。
+    auto cfg = _panel_instance.config();     // 表示パネル設定用の構造体を取得
+    cfg.pin_cs = pinCs;                      // CSが接続されているピン番号   (-1 = disable)
+    cfg.pin_rst = pinRst;                    // RSTが接続されているピン番号  (-1 = disable)
+    cfg.pin_busy = -1;                       // BUSYが接続されているピン番号 (-1 = disable)
+    cfg.panel_width = Panel::PANEL_WIDTH;    // 実際に表示可能な幅
+    cfg.panel_height = Panel::PANEL_HEIGHT;  // 実際に表示可能な高さ
+    cfg.offset_x = Panel::OFFSET_X;          // パネルのX方向オフセット量
+    cfg.offset_y = Panel::OFFSET_Y;          // パネルのY方向オフセット量
+    cfg.invert = Panel::INVERT;              // パネルの明暗が反転してしまう場合 trueに設定
+    cfg.offset_rotation = Panel::ROTATION;
+    cfg.bus_shared = Panel::PANEL_COUNT > 1; // 他のパネルとバスを共有する場合 trueに設定
+    _panel_instance.config(cfg);
+  }
+};
+
+// モード切り替えのトランジションの状態
+struct ModeTransition
+{
+  bool active;             // トランジション中かどうか
+  TransitionStyle style;   // 切り替え方
+  unsigned long startTime; // 開始時刻
+  int progress;            // 進み具合（0〜TRANSITION_ONE）
+};
+
+// 1フレームのラスタライズに必要な状態のスナップショット（目のセットごと）
+// （もう一方のコアが描いている間に状態が更新されても影響しないようコピーして渡す）
+struct FrameSnapshot
+{
+  EyeState state;            // 目の状態
+  EyePosition leftPupil;     // 左目の位置
+  EyePosition rightPupil;    // 右目の位置
+  unsigned long time;        // 描画時刻
+  ModeTransition transition; // モード切り替えのトランジション
 };
 
-LGFX_AtomS3_SPI_ST7789 ExtDisplay; // インスタンスを作成
-LGFX_Sprite eyesSprite;            // 目全体用のスプライト
-EyeState eyeState;                 // 目の状態を管理する変数
+// 目のセットのインスタンス
+// 目の状態と時刻の取得元（EyeSet）に、描く領域と描画の状態、処理時間の計測を加えたもの。
+struct EyeInstance
+{
+  EyeSet set;                // 目の状態と時刻の取得元
+  int regionX;               // 描く領域の左端（論理フレーム座標、大きさはSetLayoutの表示領域）
+  int regionY;               // 描く領域の上端
+  ModeTransition transition; // モード切り替えのトランジション
+  EyeMode shownMode;         // 最後に描画したフレームのモード
+  uint8_t staleTargets;      // 描き直しが必要なターゲット（renderTargetsの番号のビット）
+  DirtyRect drawn[2];        // ターゲットごとに最後に描いた範囲（領域の座標）
+  uint32_t updateMicros;     // 状態の更新にかかった時間の合計（マイクロ秒）
+  uint32_t rasterMicros[2];  // ターゲットごとのラスタライズにかかった時間の合計（マイクロ秒、コアごとに別の要素）
+  uint32_t frames;           // 描いたフレーム数
+};
+
+LGFX_AtomS3_SPI<ActivePanel> ExtDisplay; // インスタンスを作成（パネル2枚のときは左目用）
+LGFX_Sprite eyesSprite;                  // 目全体用のスプライト（2コア描画では1枚目）
+LGFX_Sprite eyesSpriteSub;               // 2コア描画用の2枚目のスプライト（タイルまたは交互描画の裏画面）
+RenderTarget renderTargets[2];           // スプライトごとのラスタライズ先
+EyeInstance eyeInstances[EYE_SET_COUNT]; // 目のセット
+FrameSnapshot frameBatch[EYE_SET_COUNT]; // このフレームで描く目のセットごとの状態
+DirtyRect panelLastDrawn[2];             // パネル2枚のとき、前のフレームで描画した範囲（パネルごと）
+int pendingPanel = -1;                   // パネル2枚のとき、DMA転送中のパネル（-1: なし）
+
+// 右目用のパネル（パネル2枚のプロファイルでのみ実体化される）
+template <typename Panel>
+LGFX_AtomS3_SPI<Panel> &rightDisplay()
+{
+  static LGFX_AtomS3_SPI<Panel> display(ExtDisplay, Panel::PIN_CS_RIGHT);
+  return display;
+}
+
+// 目ごとのパネル（0: 左目, 1: 右目）
+template <typename Panel>
+lgfx::LGFX_Device &panelDisplay(int index)
+{
+  if constexpr (Panel::PANEL_COUNT > 1)
+  {
+    if (index == 1)
+    {
+      return rightDisplay<Panel>();
+    }
+  }
+  return ExtDisplay;
+}
+
+// 2コア描画用のジョブ（もう一方のコアに渡す引数）
+// 1つのターゲットに、描き直しが必要な目のセットをまとめて描く
+struct RasterJobContext
+{
+  FrameSnapshot frames[EYE_SET_COUNT]; // ラスタライズするフレームの状態（目のセットごと）
+  bool draw[EYE_SET_COUNT];            // 描き直す目のセット
+  int targetIndex;                     // 描画先（renderTargetsの番号）
+};
 
 // 関数プロトタイプ宣言
-void drawEyes(EyePosition leftPupil, EyePosition rightPupil);
-void updateEyePosition();
-void drawNormalEyes(EyePosition leftPupil, EyePosition rightPupil);
-void drawSlotMachine();
-void drawSleepMode();
+void drawEyeSets();
+void updateEyeSets();
+void renderFrame();
+template <typename Layout>
+void rasterFrame(const FrameSnapshot &frame, RenderTarget &target);
+template <typename Layout>
+void rasterTarget(const RasterJobContext &job);
+template <typename Layout>
+void rasterInstance(const FrameSnapshot &frame, int set, int index);
+template <typename Layout>
+void rasterCachedFrame(const FrameSnapshot &frame, int set, int index, RenderTarget &target);
+template <typename Layout>
+void rasterNormalEyes(const FrameSnapshot &frame, RenderTarget &target);
+template <typename Layout>
+void rasterSlotMachine(const FrameSnapshot &frame, RenderTarget &target);
+template <typename Layout>
+void rasterSleepMode(const FrameSnapshot &frame, RenderTarget &target);
+template <typename Layout>
+void rasterSquareEye(RenderTarget &target, int subX, int subY);
+EyeMorph currentMorph(const FrameSnapshot &frame);
 void updateWinkers(); // ウィンカー制御用の関数
-void updateMode();    // モード更新用の関数
+void updateGpioLights(bool touch1Detected, bool touch2Detected, bool touch4Detected, unsigned long currentTime);
+void updateStripLights(bool touch1Detected, bool touch2Detected, bool touch4Detected, unsigned long currentTime);
+void handleEyeSetEvents(int set, uint8_t events);
+void updateBrightness();
+void resetStateMachine();
+void restartTrace();
+void replayTrace();
+void handleSerialCommand();
+void reportMemory();
+
+RasterJobContext workerJob;   // ワーカーコアに渡すジョブ
+RasterJobContext mainJob;     // このコアで描くジョブ
+int alternateFrontIndex = -1; // 交互描画で転送待ちのスプライト（-1: なし）
+
+bool transitionReady = false; // 前後のフレームを取っておく領域を確保できたかどうか
+
+// 切り替え先のモードごとの切り替え方
+const TransitionStyle MODE_TRANSITION_STYLES[EYE_MODE_COUNT] = {
+    TRANSITION_CROSSFADE, // 通常の目
+    TRANSITION_WIPE,      // スロットマシン
+    TRANSITION_DISSOLVE   // おやすみモード
+};
+
+// ワーカーコアで実行するラスタライズ
+void rasterJob(void *context)
+{
+  RasterJobContext *job = static_cast<RasterJobContext *>(context);
+  rasterTarget<SetLayout>(*job);
+}
+
+// workerJobのラスタライズをもう一方のコアに投入する
+// 描画量の計測中はこのコアでその場で描き、計測のカウンタを2つのコアで取り合わないようにする
+void forkRasterJob()
+{
+  if (overdrawEnabled())
+  {
+    rasterJob(&workerJob);
+    return;
+  }
+  rasterWorkerFork(rasterJob, &workerJob);
+}
+
+// ラスタライズ先の数（1コアで1枚のスプライトに描くときだけ1つ）
+int renderTargetCount()
+{
+  if (ActivePanel::PANEL_COUNT == 1 && RENDER_MODE == RENDER_SINGLE_CORE)
+  {
+    return 1;
+  }
+  return 2;
+}
+
+// renderTargets[index]に描くジョブを用意する
+// 描き直しが必要な目のセットだけを描くことにして、そのターゲットの描き直しの印を消す。
+void prepareRasterJob(RasterJobContext &job, int index)
+{
+  job.targetIndex = index;
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    EyeInstance &instance = eyeInstances[i];
+    job.frames[i] = frameBatch[i];
+    job.draw[i] = instance.staleTargets & (1 << index);
+    instance.staleTargets &= ~(1 << index);
+  }
+}
+
+// パネルごとのウィンドウの左端（論理フレームの座標、目の中心に合わせる）
+template <typename Panel>
+constexpr int eyeWindowX(int index)
+{
+  using Layout = EyeLayout<Panel>;
+  return (index == 0 ? Layout::LEFT_EYE_X : Layout::RIGHT_EYE_X) + Panel::SQUARE_EYE_WIDTH / 2 - Panel::EYE_WINDOW_WIDTH / 2;
+}
+
+// パネル1枚ぶんのフレームバッファの幅（パネル2枚のときは目のまわりのウィンドウだけ）
+template <typename Panel>
+constexpr int frameWindowWidth()
+{
+  if constexpr (Panel::PANEL_COUNT > 1)
+  {
+    return Panel::EYE_WINDOW_WIDTH;
+  }
+  else
+  {
+    return Panel::DISPLAY_WIDTH;
+  }
+}
+
+// レンダリング方式に応じたフレームバッファの合計（バイト）
+// 左右・上下のタイルは合わせてフレーム1枚分、交互描画は8bitカラーで2枚分になる
+template <typename Panel>
+constexpr size_t frameBufferBytes()
+{
+  if (Panel::PANEL_COUNT == 1 && RENDER_MODE == RENDER_ALTERNATE_FRAMES)
+  {
+    return 2 * Panel::DISPLAY_WIDTH * Panel::DISPLAY_HEIGHT;
+  }
+  return Panel::PANEL_COUNT * frameWindowWidth<Panel>() * Panel::DISPLAY_HEIGHT * Panel::COLOR_DEPTH / 8;
+}
+
+// モード切り替えのトランジションを使うかどうか
+// 交互描画ではスプライトにあるフレームと表示中のフレームが一致しないので使わない
+constexpr bool MODE_TRANSITIONS = MODE_TRANSITION_DURATION > 0 &&
+                                  (ActivePanel::PANEL_COUNT > 1 || RENDER_MODE != RENDER_ALTERNATE_FRAMES);
+static_assert(!MODE_TRANSITIONS || EYE_SET_COUNT <= TRANSITION_GROUPS, "each eye set needs its own transition group");
+
+// ライブストリーム用の保持バッファ（1bpp）とフレームのキャッシュ、トランジションの領域を含めて、プロファイルの予算に収まることをコンパイル時に確かめる
+static_assert(frameBufferBytes<ActivePanel>() + (ActivePanel::DISPLAY_WIDTH + 7) / 8 * ActivePanel::DISPLAY_HEIGHT +
+                      (FRAME_CACHE_ENABLED ? FRAME_CACHE_BYTES : 0) + (MODE_TRANSITIONS ? TRANSITION_BYTES : 0) <=
+                  ActivePanel::FRAMEBUFFER_BUDGET,
+              "framebuffers do not fit the memory budget of the panel profile");
+
+constexpr int BAND_HEIGHT = 40; // フレームバッファを確保できないときに1回に描く帯の高さ
+
+// フレームバッファの確保の結果
+enum FrameBufferPlan
+{
+  FRAME_BUFFERS_FULL,   // レンダリング方式どおりにすべて確保できた
+  FRAME_BUFFERS_BANDED, // 帯1本分のスプライトを使い回して、上から順に描いて転送する
+  FRAME_BUFFERS_NONE    // 帯1本分も確保できなかった（描画しない）
+};
+
+FrameBufferPlan frameBufferPlan = FRAME_BUFFERS_NONE;
+
+// 確保した領域をスプライトのバッファにする（スプライト自身には確保させない）
+bool attachFrameBuffer(LGFX_Sprite &sprite, const char *name, int width, int height, int depth)
+{
+  void *buffer = memoryPlanReserve(name, (size_t)width * height * depth / 8);
+  if (buffer == nullptr)
+  {
+    return false;
+  }
+  sprite.setColorDepth(depth);
+  sprite.setBuffer(buffer, width, height, (lgfx::color_depth_t)depth);
+  return true;
+}
+
+// スプライトのバッファを外して、領域を戻す
+void detachFrameBuffer(LGFX_Sprite &sprite)
+{
+  void *buffer = sprite.getBuffer();
+  sprite.deleteSprite();
+  memoryPlanRelease(buffer);
+}
+
+// フレームバッファを確保する（setupの最初、ほかの確保より前に1回）
+// 最大の空きブロックが大きいうちに、DMAで転送できる内部RAMからまとめて確保する。
+// 1枚でも確保できなければすべて戻し、帯1本分のスプライトで描く方式に切り替える。
+template <typename Panel>
+void reserveFrameBuffers()
+{
+  constexpr int width = Panel::DISPLAY_WIDTH;
+  constexpr int height = Panel::DISPLAY_HEIGHT;
+  constexpr int depth = Panel::COLOR_DEPTH;
+  bool reserved = false;
+
+  if constexpr (Panel::PANEL_COUNT > 1)
+  {
+    // パネルごとに目のまわりのウィンドウだけ
+    reserved = attachFrameBuffer(eyesSprite, "eye L", Panel::EYE_WINDOW_WIDTH, height, depth) &&
+               attachFrameBuffer(eyesSpriteSub, "eye R", Panel::EYE_WINDOW_WIDTH, height, depth);
+    renderTargets[0] = {&eyesSprite, eyeWindowX<Panel>(0), 0};
+    renderTargets[1] = {&eyesSpriteSub, eyeWindowX<Panel>(1), 0};
+  }
+  else
+  {
+    switch (RENDER_MODE)
+    {
+    case RENDER_SPLIT_LEFT_RIGHT:
+      // 左右のタイルに分割（左目と右目を別々のコアで描く）
+      reserved = attachFrameBuffer(eyesSprite, "tile L", width / 2, height, depth) &&
+                 attachFrameBuffer(eyesSpriteSub, "tile R", width - width / 2, height, depth);
+      renderTargets[0] = {&eyesSprite, 0, 0};
+      renderTargets[1] = {&eyesSpriteSub, width / 2, 0};
+      break;
+    case RENDER_SPLIT_TOP_BOTTOM:
+      // 上下のタイルに分割
+      reserved = attachFrameBuffer(eyesSprite, "tile T", width, height / 2, depth) &&
+                 attachFrameBuffer(eyesSpriteSub, "tile B", width, height - height / 2, depth);
+      renderTargets[0] = {&eyesSprite, 0, 0};
+      renderTargets[1] = {&eyesSpriteSub, 0, height / 2};
+      break;
+    case RENDER_ALTERNATE_FRAMES:
+      // フレーム全体を2枚持つため、白黒の表示に十分な8bitカラーでメモリを抑える
+      reserved = attachFrameBuffer(eyesSprite, "frame A", width, height, 8) &&
+                 attachFrameBuffer(eyesSpriteSub, "frame B", width, height, 8);
+      renderTargets[0] = {&eyesSprite, 0, 0};
+      renderTargets[1] = {&eyesSpriteSub, 0, 0};
+      break;
+    case RENDER_SINGLE_CORE:
+    default:
+      // ディスプレイと同じサイズ
+      reserved = attachFrameBuffer(eyesSprite, "frame", width, height, depth);
+      renderTargets[0] = {&eyesSprite, 0, 0};
+      break;
+    }
+  }
+
+  if (reserved)
+  {
+    frameBufferPlan = FRAME_BUFFERS_FULL;
+    return;
+  }
+
+  // 確保できた分も戻してから、帯1本分だけを確保する
+  detachFrameBuffer(eyesSprite);
+  detachFrameBuffer(eyesSpriteSub);
+  if (attachFrameBuffer(eyesSprite, "band", frameWindowWidth<Panel>(), BAND_HEIGHT, depth))
+  {
+    renderTargets[0] = {&eyesSprite, 0, 0};
+    frameBufferPlan = FRAME_BUFFERS_BANDED;
+  }
+  else
+  {
+    frameBufferPlan = FRAME_BUFFERS_NONE;
+  }
+}
+
+// パネル2枚（片目に1枚）の初期化
+// パネルの全体を黒で塗っておく（以後はパネルごとに目のまわりのウィンドウだけを描いて転送する）
+template <typename Panel>
+void beginEyePanels()
+{
+  using Layout = EyeLayout<Panel>;
+  static_assert(Panel::COLOR_DEPTH == 16, "eye panels push the sprite buffer as RGB565");
+  static_assert(Panel::DISPLAY_WIDTH == 2 * Panel::PANEL_WIDTH && Panel::DISPLAY_HEIGHT == Panel::PANEL_HEIGHT,
+                "the logical frame must be the two panels side by side");
+  static_assert(Panel::SQUARE_EYE_WIDTH / 2 + Layout::MAX_EYE_MOVE + Layout::EYE_BULGE_X <= Panel::EYE_WINDOW_WIDTH / 2,
+                "eye window is too narrow for the eye movement");
+  static_assert(Layout::DIGIT_WIDTH - Panel::INTRO_DIGIT_OFFSET_X <= Panel::EYE_WINDOW_WIDTH / 2 &&
+                    Panel::DIGIT_OFFSET_X <= Panel::EYE_WINDOW_WIDTH / 2,
+                "eye window is too narrow for the slot machine digits");
+
+  for (int i = 0; i < 2; i++)
+  {
+    panelDisplay<Panel>(i).fillScreen(TFT_BLACK);
+    panelLastDrawn[i].clear();
+  }
+  if (frameBufferPlan != FRAME_BUFFERS_FULL)
+  {
+    return; // 帯ごとに描くときはライブストリームもワーカーも使わない
+  }
+
+  // ライブストリームは2枚を並べた論理フレームを送る
+  frameStreamBegin(Panel::DISPLAY_WIDTH, Panel::DISPLAY_HEIGHT);
+  if (FRAME_CACHE_ENABLED)
+  {
+    frameCacheBegin();
+  }
+  if (MODE_TRANSITIONS)
+  {
+    transitionReady = transitionBegin(SetLayoutOf<Panel>::DISPLAY_WIDTH, EYE_SET_COUNT);
+  }
+
+  if (RENDER_MODE != RENDER_SINGLE_CORE)
+  {
+    rasterWorkerBegin(0);
+  }
+}
+
+// DMA転送中のパネルがあれば完了を待つ
+template <typename Panel>
+void finishPanelTransfer()
+{
+  if (pendingPanel >= 0)
+  {
+    lgfx::LGFX_Device &display = panelDisplay<Panel>(pendingPanel);
+    display.waitDMA();
+    display.endWrite();
+    pendingPanel = -1;
+  }
+}
+
+// パネルに変化した行の帯をDMAで転送する（完了は待たない）
+// 前のフレームで描いた範囲も黒に戻す必要があるので、両方を合わせた範囲を送る。
+// バスは2枚で共有なので、もう一方の転送が終わってから始める。
+template <typename Panel>
+void pushEyePanel(int index)
+{
+  RenderTarget &target = renderTargets[index];
+  DirtyRect damage = target.drawn;
+  damage.merge(panelLastDrawn[index]);
+  panelLastDrawn[index] = target.drawn;
+  if (damage.empty())
+  {
+    return;
+  }
+
+  finishPanelTransfer<Panel>();
+
+  // ウィンドウの幅いっぱいの行の帯なら、スプライトのバッファ上で連続している
+  int width = target.width();
+  int row = damage.y0 - target.originY;
+  const lgfx::swap565_t *pixels = static_cast<const lgfx::swap565_t *>(target.sprite->getBuffer()) + row * width;
+  lgfx::LGFX_Device &display = panelDisplay<Panel>(index);
+  display.startWrite();
+  display.pushImageDMA(target.originX - index * Panel::PANEL_WIDTH, damage.y0, width, damage.y1 - damage.y0, pixels);
+  overdrawCountPush(target.originX, damage.y0, width, damage.y1 - damage.y0);
+  pendingPanel = index;
+}
+
+// パネル2枚（片目に1枚）に描画する
+// 1コア描画では、左目の転送中に右目をラスタライズする。
+// 2コア描画では、前の転送を終えてから左右を別々のコアでラスタライズし、順に転送する。
+template <typename Panel>
+void renderEyePanels()
+{
+  using Layout = SetLayoutOf<Panel>;
+  if (RENDER_MODE == RENDER_SINGLE_CORE)
+  {
+    // ふつう転送中なのはもう一方のパネルだが、変化がなくて転送を飛ばしたときは
+    // 前のフレームの同じパネルの転送が残っているので、それを待ってからラスタライズする
+    for (int i = 0; i < 2; i++)
+    {
+      if (pendingPanel == i)
+      {
+        finishPanelTransfer<Panel>();
+      }
+      prepareRasterJob(mainJob, i);
+      rasterTarget<Layout>(mainJob);
+      pushEyePanel<Panel>(i);
+    }
+  }
+  else
+  {
+    finishPanelTransfer<Panel>();
+    prepareRasterJob(workerJob, 1);
+    forkRasterJob();
+    prepareRasterJob(mainJob, 0);
+    rasterTarget<Layout>(mainJob);
+    rasterWorkerJoin();
+    pushEyePanel<Panel>(0);
+    pushEyePanel<Panel>(1);
+  }
+  frameStreamSubmit(renderTargets, 2);
+}
 
 // 初期描画
 void drawInitialEyes()
 {
-  // スプライトの初期化（ディスプレイと同じサイズ）
-  eyesSprite.createSprite(ExtDisplay.width(), ExtDisplay.height());
+  // 目の輪郭のカバレッジと表情の輪郭を事前計算
+  EyeCoverage<SetLayout>::begin(SQUARE_EYE_COLOR);
+  EyeOutlines<SetLayout>::begin();
+
+  // 初期状態の目をすべてのターゲットに描く
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    eyeInstances[i].staleTargets = (1 << renderTargetCount()) - 1;
+  }
+
+  // パネル2枚のときは目ごとのパネルに描く（レンダリング方式は1コアか2コアかだけを使う）
+  if constexpr (ActivePanel::PANEL_COUNT > 1)
+  {
+    beginEyePanels<ActivePanel>();
+    drawEyeSets();
+    return;
+  }
+
+  // フレームバッファはreserveFrameBuffersで確保済み
   eyesSprite.fillScreen(TFT_BLACK);
+  eyesSpriteSub.fillScreen(TFT_BLACK);
+
+  if (frameBufferPlan == FRAME_BUFFERS_FULL)
+  {
+    // ライブストリーム用に前回フレームの保持バッファを確保
+    frameStreamBegin(ActivePanel::DISPLAY_WIDTH, ActivePanel::DISPLAY_HEIGHT);
+
+    // 描画状態が同じフレームのキャッシュ
+    if (FRAME_CACHE_ENABLED)
+    {
+      frameCacheBegin();
+    }
+
+    // モード切り替えのトランジションで前後のフレームを取っておく領域（目のセットごとに分ける）
+    if (MODE_TRANSITIONS)
+    {
+      transitionReady = transitionBegin(SetLayout::DISPLAY_WIDTH, EYE_SET_COUNT);
+    }
+
+    // 2コア描画ではもう一方のコアにワーカーを起動する
+    if (RENDER_MODE != RENDER_SINGLE_CORE)
+    {
+      rasterWorkerBegin(0);
+    }
+  }
 
   // 初期状態の目を描画
-  drawEyes(eyeState.leftEye, eyeState.rightEye);
+  drawEyeSets();
+}
+
+// 帯1本分のスプライトで、パネルごとに上から順に描いて転送する（フレームバッファを確保できなかったときの代わり）
+// 帯ごとにすべての目のセットをラスタライズし直すので遅いが、目は表示され続ける。
+template <typename Panel>
+void renderBanded()
+{
+  using Layout = SetLayoutOf<Panel>;
+  RenderTarget &target = renderTargets[0];
+  for (int panel = 0; panel < Panel::PANEL_COUNT; panel++)
+  {
+    int windowX = 0;
+    if constexpr (Panel::PANEL_COUNT > 1)
+    {
+      windowX = eyeWindowX<Panel>(panel);
+    }
+    lgfx::LGFX_Device &display = panelDisplay<Panel>(panel);
+    for (int y = 0; y < Panel::DISPLAY_HEIGHT; y += BAND_HEIGHT)
+    {
+      target.originX = windowX;
+      target.originY = y;
+
+      // タイルで割り切れずに残った端は目のセットが塗らないので、帯ごとに黒にしておく
+      target.sprite->fillScreen(TFT_BLACK);
+      for (int i = 0; i < EYE_SET_COUNT; i++)
+      {
+        const EyeInstance &instance = eyeInstances[i];
+        RenderTarget view = target.region(instance.regionX, instance.regionY, Layout::DISPLAY_WIDTH, Layout::DISPLAY_HEIGHT);
+        if (!view.bounds().empty())
+        {
+          view.applyClip();
+          rasterFrame<Layout>(frameBatch[i], view);
+          view.releaseClip();
+        }
+      }
+      target.sprite->pushSprite(&display, windowX - panel * Panel::PANEL_WIDTH, y);
+      overdrawCountPush(windowX, y, target.width(), target.height());
+    }
+  }
+  // すべての目のセットを描き直したので、描き直しの印を消す
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    eyeInstances[i].staleTargets = 0;
+  }
+}
+
+// frameBatchの目のセットをラスタライズして画面に転送する
+void renderFrame()
+{
+  if (frameBufferPlan != FRAME_BUFFERS_FULL)
+  {
+    if (frameBufferPlan == FRAME_BUFFERS_BANDED)
+    {
+      renderBanded<ActivePanel>();
+    }
+    return;
+  }
+
+  if constexpr (ActivePanel::PANEL_COUNT > 1)
+  {
+    renderEyePanels<ActivePanel>();
+    return;
+  }
+
+  switch (RENDER_MODE)
+  {
+  case RENDER_SPLIT_LEFT_RIGHT:
+  case RENDER_SPLIT_TOP_BOTTOM:
+    // 2枚目のタイルをもう一方のコアで描きつつ、1枚目をこのコアで描く
+    prepareRasterJob(workerJob, 1);
+    forkRasterJob();
+    prepareRasterJob(mainJob, 0);
+    rasterTarget<SetLayout>(mainJob);
+    rasterWorkerJoin();
+
+    // 両方のタイルがそろってから転送
+    for (int i = 0; i < 2; i++)
+    {
+      RenderTarget &target = renderTargets[i];
+      target.sprite->pushSprite(&ExtDisplay, target.originX, target.originY);
+      overdrawCountPush(target.originX, target.originY, target.width(), target.height());
+    }
+    frameStreamSubmit(renderTargets, 2);
+    break;
+
+  case RENDER_ALTERNATE_FRAMES:
+  {
+    // 前のフレームのラスタライズ完了を待つ
+    rasterWorkerJoin();
+    int readyIndex = alternateFrontIndex;
+
+    // 次のフレームをもう一方のコアで描きつつ、描き上がったフレームをこのコアで転送する
+    // （2つのコアが交互にラスタライズと転送を受け持つため、表示は1フレーム遅れる）
+    int backIndex = (readyIndex == 0) ? 1 : 0;
+    prepareRasterJob(workerJob, backIndex);
+    forkRasterJob();
+    alternateFrontIndex = backIndex;
+
+    if (readyIndex >= 0)
+    {
+      renderTargets[readyIndex].sprite->pushSprite(&ExtDisplay, 0, 0);
+      overdrawCountPush(0, 0, renderTargets[readyIndex].width(), renderTargets[readyIndex].height());
+      frameStreamSubmit(&renderTargets[readyIndex], 1);
+    }
+    break;
+  }
+
+  case RENDER_SINGLE_CORE:
+  default:
+    prepareRasterJob(mainJob, 0);
+    rasterTarget<SetLayout>(mainJob);
+    // スプライトを画面に転送
+    eyesSprite.pushSprite(&ExtDisplay, 0, 0);
+    overdrawCountPush(0, 0, eyesSprite.width(), eyesSprite.height());
+    frameStreamSubmit(renderTargets, 1);
+    break;
+  }
+}
+
+// 1フレームで描くフレームバッファのピクセル数（描画量の計測の分母）
+// 交互描画では1フレームに1枚、帯で描くときは帯を画面の高さ分、それ以外はすべてのターゲットを描く。
+uint32_t framebufferPixels()
+{
+  const RenderTarget &first = renderTargets[0];
+  if (frameBufferPlan == FRAME_BUFFERS_BANDED)
+  {
+    return (uint32_t)ActivePanel::PANEL_COUNT * first.width() * ActivePanel::DISPLAY_HEIGHT;
+  }
+  if (ActivePanel::PANEL_COUNT == 1 && RENDER_MODE == RENDER_ALTERNATE_FRAMES)
+  {
+    return (uint32_t)first.width() * first.height();
+  }
+  uint32_t pixels = 0;
+  for (int i = 0; i < renderTargetCount(); i++)
+  {
+    pixels += (uint32_t)renderTargets[i].width() * renderTargets[i].height();
+  }
+  return pixels;
+}
+
+// 描画量を集計する区分（目のモードと、その中の状態）
+enum OverdrawBucket
+{
+  OVERDRAW_NORMAL_IDLE,                          // 通常の目（止まっている）
+  OVERDRAW_NORMAL_MOVING,                        // 通常の目（移動中）
+  OVERDRAW_NORMAL_BLINK,                         // 通常の目（瞬き中）
+  OVERDRAW_NORMAL_MORPH,                         // 通常の目（表情の切り替え中）
+  OVERDRAW_SLOT,                                 // スロットマシン（ここからSlotStateの順）
+  OVERDRAW_SLEEP = OVERDRAW_SLOT + SLOT_END + 1, // おやすみモード（ここからSleepStateの順）
+  OVERDRAW_BUCKET_COUNT = OVERDRAW_SLEEP + SLEEP_COMPLETE + 1
+};
+
+const char *const OVERDRAW_BUCKET_NAMES[OVERDRAW_BUCKET_COUNT] = {
+    "normal-idle", "normal-moving", "normal-blink", "normal-morph",
+    "slot-start", "slot-spinning", "slot-result", "slot-end",
+    "sleep-start", "sleep-normal", "sleep-closing", "sleep-dimming", "sleep-complete"};
+static_assert(OVERDRAW_BUCKET_COUNT <= OVERDRAW_MAX_BUCKETS, "too many overdraw buckets");
+
+// フレームの区分
+int overdrawBucket(const FrameSnapshot &frame)
+{
+  const EyeState &state = frame.state;
+  switch (state.mode)
+  {
+  case SLOT_MACHINE:
+    return OVERDRAW_SLOT + state.slotState;
+  case SLEEP_MODE:
+    return OVERDRAW_SLEEP + state.sleepState;
+  default:
+  {
+    EyeMorph morph = currentMorph(frame);
+    if (state.isMoving)
+    {
+      return OVERDRAW_NORMAL_MOVING;
+    }
+    if (morph.blink > 0)
+    {
+      return OVERDRAW_NORMAL_BLINK;
+    }
+    return morph.ratio < MORPH_ONE ? OVERDRAW_NORMAL_MORPH : OVERDRAW_NORMAL_IDLE;
+  }
+  }
+}
+
+// 目のセットの切り替え前後のフレームを取っておき、トランジションを始める
+// スプライトに残っている切り替え前のフレームを取ってから、切り替え先の最初のフレームを描いて取る。
+// 領域が足りずに取れなかったときは、トランジションなしで切り替える。
+void startModeTransition(int set)
+{
+  EyeInstance &instance = eyeInstances[set];
+  const FrameSnapshot &frame = frameBatch[set];
+
+  // トランジション中にまた切り替えたときも、切り替え先は混ぜずにラスタライズする
+  // （スナップショットのトランジションが残っていると、消したばかりの前後のフレームを混ぜてしまう）
+  instance.transition.active = false;
+  frameBatch[set].transition.active = false;
+  if (!transitionReady)
+  {
+    return;
+  }
+  if constexpr (ActivePanel::PANEL_COUNT > 1)
+  {
+    finishPanelTransfer<ActivePanel>(); // DMA転送中のスプライトには描かない
+  }
+
+  transitionReset(set);
+  int count = renderTargetCount();
+  for (int i = 0; i < count; i++)
+  {
+    RenderTarget view = renderTargets[i].region(instance.regionX, instance.regionY, SetLayout::DISPLAY_WIDTH, SetLayout::DISPLAY_HEIGHT);
+    view.drawn = instance.drawn[i];
+    if (!transitionCaptureFrom(set, i, view))
+    {
+      return;
+    }
+  }
+  for (int i = 0; i < count; i++)
+  {
+    RenderTarget view = renderTargets[i].region(instance.regionX, instance.regionY, SetLayout::DISPLAY_WIDTH, SetLayout::DISPLAY_HEIGHT);
+    rasterInstance<SetLayout>(frame, set, i);
+    view.drawn = instance.drawn[i];
+    if (!transitionCaptureTo(set, i, view))
+    {
+      return;
+    }
+  }
+  instance.transition = {true, MODE_TRANSITION_STYLES[frame.state.mode], frame.time, 0};
 }
 
-// 目を描画する関数（スプライト使用）
-void drawEyes(EyePosition leftPupil, EyePosition rightPupil)
+// 描き直しが必要な目のセットをまとめて描画する（スプライト使用）
+// すべてのセットの状態をスナップショットにしてから、ターゲットごとに1回のラスタライズと転送で描く。
+void drawEyeSets()
+{
+  bool drawing[EYE_SET_COUNT];
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    EyeInstance &instance = eyeInstances[i];
+    const EyeState &state = instance.set.state;
+    frameBatch[i] = {state, state.leftEye, state.rightEye, instance.set.now, instance.transition};
+    drawing[i] = instance.staleTargets != 0;
+    if (!drawing[i])
+    {
+      continue;
+    }
+
+    // モードが変わったら、トランジションの間は前後のフレームを混ぜたものを描く
+    if (MODE_TRANSITIONS && state.initialized && state.mode != instance.shownMode)
+    {
+      startModeTransition(i);
+    }
+    ModeTransition &transition = instance.transition;
+    if (transition.active)
+    {
+      unsigned long elapsed = min(instance.set.now - transition.startTime, (unsigned long)MODE_TRANSITION_DURATION);
+      transition.progress = elapsed * TRANSITION_ONE / MODE_TRANSITION_DURATION;
+    }
+    frameBatch[i].transition = transition;
+  }
+
+  // 描画量の区分は先頭の目のセットの状態で決める
+  overdrawFrameBegin(overdrawBucket(frameBatch[0]));
+  renderFrame();
+  overdrawFrameEnd();
+
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    if (!drawing[i])
+    {
+      continue;
+    }
+    EyeInstance &instance = eyeInstances[i];
+    EyeState &state = instance.set.state;
+    if (instance.transition.active && instance.transition.progress == TRANSITION_ONE)
+    {
+      // 混ぜていたのは切り替え先の最初のフレームなので、終わったら今の状態を1回ラスタライズし直す
+      // （トランジション中に始まって終わった瞬きや視線の移動が画面に残らないように）
+      instance.transition.active = false;
+      instance.staleTargets = (1 << renderTargetCount()) - 1;
+    }
+    instance.shownMode = state.mode;
+    instance.frames++;
+
+    // 現在の位置を前回の位置として保存
+    state.prevLeftEye = state.leftEye;
+    state.prevRightEye = state.rightEye;
+    state.initialized = true;
+  }
+}
+
+// フレームの状態をターゲットにラスタライズする
+template <typename Layout>
+void rasterFrame(const FrameSnapshot &frame, RenderTarget &target)
 {
   // 目のモードに応じて描画関数を呼び出す
-  switch (eyeState.mode)
+  switch (frame.state.mode)
   {
   case NORMAL_EYE:
-    drawNormalEyes(leftPupil, rightPupil);
+    rasterNormalEyes<Layout>(frame, target);
     break;
   case SLOT_MACHINE:
-    drawSlotMachine();
+    rasterSlotMachine<Layout>(frame, target);
     break;
   case SLEEP_MODE:
-    drawSleepMode();
+    rasterSleepMode<Layout>(frame, target);
     break;
   default:
-    drawNormalEyes(leftPupil, rightPupil);
+    rasterNormalEyes<Layout>(frame, target);
     break;
   }
+}
+
+// フレームのキャッシュのキー
+// 描く内容が同じになる状態には同じキーを付ける（スロットの終了後やおやすみモードの開いた目は、
+// 通常の目で中央を見ているときと同じキーになる）。キーは0にならない。
+enum FrameCacheKind
+{
+  FRAME_KEY_EYES = 1, // 目（位置・表情・瞬き）
+  FRAME_KEY_DIGITS,   // スロットの結果の数字
+  FRAME_KEY_BLANK     // 何も描かない
+};
+
+constexpr int FRAME_KEY_PLACEMENT_SHIFT = 56; // 目のセットの領域とターゲットの重なり方（上位8bit）
+
+static_assert(SetLayout::MAX_EYE_MOVE * SUBPIXEL_STEPS < 128, "eye offsets must fit the 8-bit fields of the cache key");
+static_assert(EXPRESSION_COUNT <= 8, "expressions must fit the 3-bit fields of the cache key");
+static_assert(EYE_SET_COUNT < 255, "eye sets must fit the 8-bit placement field of the cache key");
+
+// 目のキー（位置は中央からのずれ、サブピクセル単位）
+uint64_t eyesCacheKey(int leftX, int rightX, int y, EyeMorph morph)
+{
+  // 切り替えが終わっていれば、切り替え前の表情は形に影響しない
+  if (morph.ratio == MORPH_ONE)
+  {
+    morph.from = morph.to;
+  }
+  return FRAME_KEY_EYES | (uint64_t)(leftX + 128) << 2 | (uint64_t)(rightX + 128) << 10 | (uint64_t)(y + 128) << 18 |
+         (uint64_t)morph.from << 26 | (uint64_t)morph.to << 29 | (uint64_t)morph.ratio << 32 | (uint64_t)morph.blink << 41;
+}
+
+// フレームのキーを求める（時間とともに動き続けるフレームはキャッシュしない）
+bool frameCacheKey(const FrameSnapshot &frame, uint64_t &key)
+{
+  const EyeState &state = frame.state;
+  const EyeMorph open = {EXPRESSION_OPEN, EXPRESSION_OPEN, MORPH_ONE, 0};
+  switch (state.mode)
+  {
+  case NORMAL_EYE:
+    key = eyesCacheKey(frame.leftPupil.x, frame.rightPupil.x, frame.leftPupil.y, currentMorph(frame));
+    return true;
+
+  case SLOT_MACHINE:
+    if (state.slotState == SLOT_RESULT)
+    {
+      key = FRAME_KEY_DIGITS | (uint64_t)state.slotNumber << 2;
+      return true;
+    }
+    if (state.slotState == SLOT_END && frame.time - state.slotStartTime >= 1500)
+    {
+      key = eyesCacheKey(0, 0, 0, open);
+      return true;
+    }
+    return false;
+
+  case SLEEP_MODE:
+    switch (state.sleepState)
+    {
+    case SLEEP_NORMAL:
+      key = eyesCacheKey(0, 0, 0, open);
+      return true;
+    case SLEEP_DIMMING:
+      key = eyesCacheKey(0, 0, 0, {EXPRESSION_CLOSED, EXPRESSION_CLOSED, MORPH_ONE, 0});
+      return true;
+    case SLEEP_START:
+    case SLEEP_COMPLETE:
+      key = FRAME_KEY_BLANK;
+      return true;
+    default:
+      return false;
+    }
+
+  default:
+    return false;
+  }
+}
+
+// ジョブの目のセットをターゲットに描き、ターゲットの描画した範囲をすべてのセットの範囲を合わせたものにする
+// （描き直さなかったセットも、前に描いたものがスプライトに残っている）
+template <typename Layout>
+void rasterTarget(const RasterJobContext &job)
+{
+  RenderTarget &target = renderTargets[job.targetIndex];
+  target.drawn.clear();
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    if (job.draw[i])
+    {
+      rasterInstance<Layout>(job.frames[i], i, job.targetIndex);
+    }
+    const EyeInstance &instance = eyeInstances[i];
+    const DirtyRect &drawn = instance.drawn[job.targetIndex];
+    target.drawn.add(drawn.x0 + instance.regionX, drawn.y0 + instance.regionY, drawn.x1 - drawn.x0, drawn.y1 - drawn.y0);
+  }
+}
+
+// 目のセットのフレームを、renderTargets[index]の中のセットの領域にラスタライズする（重ならなければ何もしない）
+template <typename Layout>
+void rasterInstance(const FrameSnapshot &frame, int set, int index)
+{
+  EyeInstance &instance = eyeInstances[set];
+  RenderTarget view = renderTargets[index].region(instance.regionX, instance.regionY, Layout::DISPLAY_WIDTH, Layout::DISPLAY_HEIGHT);
+  if (view.bounds().empty())
+  {
+    instance.drawn[index].clear();
+    return;
+  }
+  unsigned long start = micros();
+  view.applyClip();
+  rasterCachedFrame<Layout>(frame, set, index, view);
+  view.releaseClip();
+  instance.drawn[index] = view.drawn;
+  instance.rasterMicros[index] += micros() - start;
+}
+
+// 目のセットのフレームを、ターゲットから切り出したセットの領域にラスタライズする
+// 描画状態が同じフレームはキャッシュから展開し、ミスしたときはラスタライズした結果を登録する
+// キャッシュはターゲットごとなので、領域がターゲットに収まっているセットどうしは同じエントリを使う
+// （一部だけが重なるセットは、重なり方がセットごとに違うのでセットの番号をキーに加える）。
+template <typename Layout>
+void rasterCachedFrame(const FrameSnapshot &frame, int set, int index, RenderTarget &target)
+{
+  const ModeTransition &transition = frame.transition;
+  if (transition.active)
+  {
+    // トランジション中は取っておいた前後のフレームを混ぜるだけでラスタライズしない
+    transitionBlend(set, index, target, transition.style, transition.progress);
+    return;
+  }
+  uint64_t key = 0;
+  bool cacheable = FRAME_CACHE_ENABLED && frameCacheKey(frame, key);
+  if (cacheable)
+  {
+    DirtyRect area = target.bounds();
+    bool whole = area.x0 == 0 && area.y0 == 0 && area.x1 == Layout::DISPLAY_WIDTH && area.y1 == Layout::DISPLAY_HEIGHT;
+    key |= (uint64_t)(whole ? 0 : set + 1) << FRAME_KEY_PLACEMENT_SHIFT;
+  }
+  if (cacheable && frameCacheLookup(index, key, target))
+  {
+    // 展開した範囲を書き込みとして数える
+    const DirtyRect &drawn = target.drawn;
+    overdrawCountWrite(drawn.x0 + target.regionX, drawn.y0 + target.regionY, drawn.x1 - drawn.x0, drawn.y1 - drawn.y0);
+    return;
+  }
+  rasterFrame<Layout>(frame, target);
+  if (cacheable)
+  {
+    frameCacheStore(index, key, target);
+  }
+}
+
+// 数字を1つ描画する（ターゲットと重ならない場合は何もしない）
+template <typename Layout>
+void rasterDigit(RenderTarget &target, int x, int y, int digit)
+{
+  if (target.overlaps(x, y, Layout::DIGIT_WIDTH, Layout::DIGIT_HEIGHT))
+  {
+    target.setCursor(x, y);
+    target.printDigit(digit);
+  }
+}
+
+// 四角い目を1つ描画する（位置はサブピクセル単位）
+template <typename Layout>
+void rasterSquareEye(RenderTarget &target, int subX, int subY)
+{
+  if (EYE_ANTIALIAS)
+  {
+    EyeCoverage<Layout>::raster(target, subX, subY);
+  }
+  else
+  {
+    target.fillRoundRect(subpixelToPixel(subX), subpixelToPixel(subY),
+                         Layout::SQUARE_EYE_WIDTH, Layout::SQUARE_EYE_HEIGHT, Layout::SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
+  }
+}
+
+// フレームの時刻での表情の切り替えと瞬きの進み具合
+EyeMorph currentMorph(const FrameSnapshot &frame)
+{
+  const EyeState &state = frame.state;
+  EyeMorph morph = {state.prevExpression, state.expression, MORPH_ONE, 0};
+
+  // 表情の切り替え
+  unsigned long morphElapsed = frame.time - state.expressionStartTime;
+  if (morphElapsed < EXPRESSION_MORPH_DURATION)
+  {
+    morph.ratio = morphElapsed * MORPH_ONE / EXPRESSION_MORPH_DURATION;
+  }
 
-  // 現在の位置を前回の位置として保存
-  eyeState.prevLeftEye = leftPupil;
-  eyeState.prevRightEye = rightPupil;
-  eyeState.initialized = true;
+  // 瞬き：前半でまぶたを閉じ、後半で開く
+  unsigned long blinkElapsed = frame.time - state.blinkStartTime;
+  if (state.isBlinking && blinkElapsed < BLINK_DURATION)
+  {
+    int phase = blinkElapsed * 2 * MORPH_ONE / BLINK_DURATION;
+    morph.blink = phase <= MORPH_ONE ? phase : 2 * MORPH_ONE - phase;
+  }
+  return morph;
 }
 
 // 通常の目（四角い目）を描画する関数
-void drawNormalEyes(EyePosition leftPupil, EyePosition rightPupil)
+template <typename Layout>
+void rasterNormalEyes(const FrameSnapshot &frame, RenderTarget &target)
 {
   // 背景を黒で塗りつぶし
-  eyesSprite.fillScreen(TFT_BLACK);
+  target.fillScreen(TFT_BLACK);
 
-  // 瞬き中かどうかを確認
-  unsigned long currentTime = millis();
-  bool drawBlink = eyeState.isBlinking && (currentTime - eyeState.blinkStartTime < BLINK_DURATION);
+  // 左右の目の位置（サブピクセル単位）
+  int leftEyeX = toSubpixel(Layout::LEFT_EYE_X) + frame.leftPupil.x;
+  int rightEyeX = toSubpixel(Layout::RIGHT_EYE_X) + frame.rightPupil.x;
+  int eyeY = toSubpixel(Layout::EYE_Y) + frame.leftPupil.y;
 
-  if (!drawBlink)
+  EyeMorph morph = currentMorph(frame);
+  if (morph.to == EXPRESSION_OPEN && morph.ratio == MORPH_ONE && morph.blink == 0)
   {
-    // 左右の目の白目部分を描画（四角形）
-    int leftEyeX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2 + leftPupil.x;
-    int rightEyeX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2 + rightPupil.x;
-    int eyeY = DISPLAY_CENTER_Y - SQUARE_EYE_HEIGHT / 2 + leftPupil.y;
-
-    // 角丸四角形で目を描画
-    eyesSprite.fillRoundRect(leftEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-    eyesSprite.fillRoundRect(rightEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
+    // 開いた目は角丸四角形で描画
+    rasterSquareEye<Layout>(target, leftEyeX, eyeY);
+    rasterSquareEye<Layout>(target, rightEyeX, eyeY);
   }
   else
   {
-    // 瞬き中は太い線を描画（3ピクセル）
-    int leftStartX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2 + leftPupil.x;
-    int leftEndX = leftStartX + SQUARE_EYE_WIDTH;
-    int rightStartX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2 + rightPupil.x;
-    int rightEndX = rightStartX + SQUARE_EYE_WIDTH;
-    int lineY = DISPLAY_CENTER_Y + leftPupil.y;
-
-    // 画面からはみ出さないように制限
-    leftStartX = constrain(leftStartX, 0, DISPLAY_WIDTH - 1);
-    leftEndX = constrain(leftEndX, 0, DISPLAY_WIDTH - 1);
-    rightStartX = constrain(rightStartX, 0, DISPLAY_WIDTH - 1);
-    rightEndX = constrain(rightEndX, 0, DISPLAY_WIDTH - 1);
-
-    // 3ピクセルの太さの線を描画（中央と上下に1ピクセルずつ）
-    for (int i = -1; i <= 1; i++)
-    {
-      int y = lineY + i;
-      if (y >= 0 && y < DISPLAY_HEIGHT)
-      {
-        eyesSprite.drawLine(leftStartX, y, leftEndX, y, SQUARE_EYE_COLOR);
-        eyesSprite.drawLine(rightStartX, y, rightEndX, y, SQUARE_EYE_COLOR);
-      }
-    }
+    // 表情の切り替え中・瞬き中・開いた目以外の表情は輪郭から描画（右目は左右反転）
+    EyeOutlines<Layout>::raster(target, leftEyeX, eyeY, morph, false);
+    EyeOutlines<Layout>::raster(target, rightEyeX, eyeY, morph, true);
   }
-
-  // スプライトを画面に転送
-  eyesSprite.pushSprite(&ExtDisplay, 0, 0);
 }
 
 // スロットマシンモードを描画する関数
-void drawSlotMachine()
+template <typename Layout>
+void rasterSlotMachine(const FrameSnapshot &frame, RenderTarget &target)
 {
-  unsigned long currentTime = millis();
-  unsigned long elapsedTime = currentTime - eyeState.slotStartTime;
+  const EyeState &state = frame.state;
+  unsigned long elapsedTime = frame.time - state.slotStartTime;
 
   // 背景を黒で塗りつぶし
-  eyesSprite.fillScreen(TFT_BLACK);
+  target.fillScreen(TFT_BLACK);
 
   // スロットマシンの状態に応じて描画
-  switch (eyeState.slotState)
+  switch (state.slotState)
   {
   case SLOT_START:
+  {
     // 開始状態：通常の目から開始し、下に流れていく
-    if (elapsedTime < 1500) // 1.5秒かけて目を下に流す
-    {
-      // 進行度（0.0～1.0）
-      float progress = elapsedTime / 1500.0f;
+    // 進行度（0.0～1.0）
+    float progress = (float)elapsedTime / SLOT_SCROLL_DURATION;
 
-      // 左右の目の白目部分を描画（四角形）- 下に流れていく
-      int leftEyeX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      int rightEyeX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      int eyeY = DISPLAY_CENTER_Y - SQUARE_EYE_HEIGHT / 2 + (int)(DISPLAY_HEIGHT * progress); // 下に移動
+    // 左右の目の白目部分を描画（四角形）- 下に流れていく
+    int leftEyeX = Layout::LEFT_EYE_X;
+    int rightEyeX = Layout::RIGHT_EYE_X;
+    int eyeY = Layout::EYE_Y + (int)(Layout::DISPLAY_HEIGHT * progress); // 下に移動
 
-      // 画面内にある場合のみ描画
-      if (eyeY < DISPLAY_HEIGHT)
-      {
-        // 角丸四角形で目を描画
-        eyesSprite.fillRoundRect(leftEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-        eyesSprite.fillRoundRect(rightEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-      }
-
-      // 同時に数字が上から流れてくる（まだ画面外）
-      eyesSprite.setTextSize(10); // より大きなサイズに
-      eyesSprite.setTextColor(TFT_WHITE);
+    // 画面内にある場合のみ描画
+    if (eyeY < Layout::DISPLAY_HEIGHT)
+    {
+      // 角丸四角形で目を描画
+      rasterSquareEye<Layout>(target, toSubpixel(leftEyeX), toSubpixel(eyeY));
+      rasterSquareEye<Layout>(target, toSubpixel(rightEyeX), toSubpixel(eyeY));
+    }
 
-      // 左目（10の位）
-      for (int i = 0; i < 4; i++)
-      {
-        int digit = (1 + i) % 10; // 9から始まる
-        // 画面上部から流れてくる（まだ見えない）- 目と同じ速度で移動
-        int y = -300 + (int)(progress * DISPLAY_HEIGHT) + i * 80;
-        if (y > -80 && y < DISPLAY_HEIGHT)
-        {
-          eyesSprite.setCursor(DISPLAY_CENTER_X - EYE_SPACING / 2 - 25, y);
-          eyesSprite.printf("%d", digit);
-        }
-      }
+    // 同時に数字が上から流れてくる（まだ画面外）
+    target.setTextSize(Layout::TEXT_SIZE); // より大きなサイズに
+    target.setTextColor(TFT_WHITE);
 
-      // 右目（1の位）
-      for (int i = 0; i < 4; i++)
+    for (int i = 0; i < 4; i++)
+    {
+      int digit = (1 + i) % 10; // 9から始まる
+      // 画面上部から流れてくる（まだ見えない）- 目と同じ速度で移動
+      int y = Layout::INTRO_DIGIT_START_Y + (int)(progress * Layout::DISPLAY_HEIGHT) + i * Layout::DIGIT_PITCH;
+      if (y > -Layout::DIGIT_HEIGHT && y < Layout::DISPLAY_HEIGHT)
       {
-        int digit = (1 + i) % 10; // 9から始まる
-        // 画面上部から流れてくる（まだ見えない）- 目と同じ速度で移動
-        int y = -300 + (int)(progress * DISPLAY_HEIGHT) + i * 80;
-        if (y > -80 && y < DISPLAY_HEIGHT)
-        {
-          eyesSprite.setCursor(DISPLAY_CENTER_X + EYE_SPACING / 2 - 25, y);
-          eyesSprite.printf("%d", digit);
-        }
+        rasterDigit<Layout>(target, Layout::LEFT_INTRO_DIGIT_X, y, digit);  // 左目（10の位）
+        rasterDigit<Layout>(target, Layout::RIGHT_INTRO_DIGIT_X, y, digit); // 右目（1の位）
       }
     }
-    else
-    {
-      // 次の状態へ
-      eyeState.slotState = SLOT_SPINNING;
-      eyeState.slotStartTime = currentTime;
-      // スロットの回転時間は3000ms
-      eyeState.slotNumber = 3000;
-    }
     break;
+  }
 
   case SLOT_SPINNING:
+  {
     // 回転中：3000msの数字を回転させる
-    if (elapsedTime < eyeState.slotNumber)
-    {
-      // ドラムリールのような表現（下から上に数字が流れる）
-      eyesSprite.setTextSize(10); // より大きなサイズに
-      eyesSprite.setTextColor(TFT_WHITE);
+    // ドラムリールのような表現（下から上に数字が流れる）
+    target.setTextSize(Layout::TEXT_SIZE); // より大きなサイズに
+    target.setTextColor(TFT_WHITE);
 
-      // 左目（10の位）のドラムリール
-      int leftDigit = (elapsedTime / 200) % 10; // 200msごとに切り替え（ゆっくり）
-      for (int i = -2; i <= 2; i++)
-      {
-        int digit = (leftDigit + i + 10) % 10; // 循環させる
+    // 左目（10の位）のドラムリール
+    int leftDigit = (elapsedTime / 200) % 10; // 200msごとに切り替え（ゆっくり）
+    for (int i = -2; i <= 2; i++)
+    {
+      int digit = (leftDigit + i + 10) % 10; // 循環させる
 
-        // 滑らかに移動（200msのサイクルを60フレームに分割）
-        float cycleProgress = (elapsedTime % 200) / 200.0f;
-        int y = DISPLAY_CENTER_Y - 35 + i * 80 - (int)(cycleProgress * 80);
+      // 滑らかに移動（200msのサイクルを60フレームに分割）
+      float cycleProgress = (elapsedTime % 200) / 200.0f;
+      int y = Layout::DIGIT_Y + i * Layout::DIGIT_PITCH - (int)(cycleProgress * Layout::DIGIT_PITCH);
 
-        // 画面内に表示される場合のみ描画
-        if (y > -80 && y < DISPLAY_HEIGHT)
-        {
-          eyesSprite.setCursor(DISPLAY_CENTER_X - EYE_SPACING / 2 - 30, y);
-          eyesSprite.printf("%d", digit);
-        }
+      // 画面内に表示される場合のみ描画
+      if (y > -Layout::DIGIT_HEIGHT && y < Layout::DISPLAY_HEIGHT)
+      {
+        rasterDigit<Layout>(target, Layout::LEFT_DIGIT_X, y, digit);
       }
+    }
 
-      // 右目（1の位）のドラムリール
-      int rightDigit = (elapsedTime / 150) % 10; // 150msごとに切り替え（左より速く）
-      for (int i = -2; i <= 2; i++)
-      {
-        int digit = (rightDigit + i + 10) % 10; // 循環させる
+    // 右目（1の位）のドラムリール
+    int rightDigit = (elapsedTime / 150) % 10; // 150msごとに切り替え（左より速く）
+    for (int i = -2; i <= 2; i++)
+    {
+      int digit = (rightDigit + i + 10) % 10; // 循環させる
 
-        // 滑らかに移動（150msのサイクルを60フレームに分割）
-        float cycleProgress = (elapsedTime % 150) / 150.0f;
-        int y = DISPLAY_CENTER_Y - 35 + i * 80 - (int)(cycleProgress * 80);
+      // 滑らかに移動（150msのサイクルを60フレームに分割）
+      float cycleProgress = (elapsedTime % 150) / 150.0f;
+      int y = Layout::DIGIT_Y + i * Layout::DIGIT_PITCH - (int)(cycleProgress * Layout::DIGIT_PITCH);
 
-        // 画面内に表示される場合のみ描画
-        if (y > -80 && y < DISPLAY_HEIGHT)
-        {
-          eyesSprite.setCursor(DISPLAY_CENTER_X + EYE_SPACING / 2 - 30, y);
-          eyesSprite.printf("%d", digit);
-        }
+      // 画面内に表示される場合のみ描画
+      if (y > -Layout::DIGIT_HEIGHT && y < Layout::DISPLAY_HEIGHT)
+      {
+        rasterDigit<Layout>(target, Layout::RIGHT_DIGIT_X, y, digit);
       }
     }
-    else
-    {
-      // 回転終了、結果を決定
-      eyeState.slotNumber = random(1, 21); // 01から20までのランダムな数字
-      eyeState.slotState = SLOT_RESULT;
-      eyeState.slotStartTime = currentTime;
-    }
     break;
+  }
 
   case SLOT_RESULT:
+  {
     // 結果表示：3秒間結果を表示
-    if (elapsedTime < 3000)
-    {
-      eyesSprite.setTextSize(10); // より大きなサイズに
-      eyesSprite.setTextColor(TFT_WHITE);
+    target.setTextSize(Layout::TEXT_SIZE); // より大きなサイズに
+    target.setTextColor(TFT_WHITE);
 
-      // 結果の数字を取得
-      int tens = eyeState.slotNumber / 10; // 10の位
-      int ones = eyeState.slotNumber % 10; // 1の位
+    // 結果の数字を取得
+    int tens = state.slotNumber / 10; // 10の位
+    int ones = state.slotNumber % 10; // 1の位
 
-      // 左目に10の位を表示
-      eyesSprite.setCursor(DISPLAY_CENTER_X - EYE_SPACING / 2 - 30, DISPLAY_CENTER_Y - 35);
-      eyesSprite.printf("%d", tens);
-
-      // 右目に1の位を表示
-      eyesSprite.setCursor(DISPLAY_CENTER_X + EYE_SPACING / 2 - 30, DISPLAY_CENTER_Y - 35);
-      eyesSprite.printf("%d", ones);
-    }
-    else
-    {
-      // 結果表示終了、終了状態へ
-      eyeState.slotState = SLOT_END;
-      eyeState.slotStartTime = currentTime;
-    }
+    // 左目に10の位、右目に1の位を表示
+    rasterDigit<Layout>(target, Layout::LEFT_DIGIT_X, Layout::DIGIT_Y, tens);
+    rasterDigit<Layout>(target, Layout::RIGHT_DIGIT_X, Layout::DIGIT_Y, ones);
     break;
+  }
 
   case SLOT_END:
     // 終了状態：数字が上に消えて目が中央に表示される
@@ -446,29 +1304,19 @@ void drawSlotMachine()
       if (progress < 0.5f)
       { // 最初の50%の時間は数字が上に流れる
         // 数字が上に流れていく
-        eyesSprite.setTextSize(10);
-        eyesSprite.setTextColor(TFT_WHITE);
-
-        // 左目（10の位）の数字が上に流れる
-        int tens = eyeState.slotNumber / 10;
-        int leftY = DISPLAY_CENTER_Y - 35 - (int)((progress / 0.5f) * DISPLAY_HEIGHT);
-        if (leftY > -80 && leftY < DISPLAY_HEIGHT)
-        {
-          eyesSprite.setCursor(DISPLAY_CENTER_X - EYE_SPACING / 2 - 30, leftY);
-          eyesSprite.printf("%d", tens);
-        }
+        target.setTextSize(Layout::TEXT_SIZE);
+        target.setTextColor(TFT_WHITE);
 
-        // 右目（1の位）の数字が上に流れる
-        int ones = eyeState.slotNumber % 10;
-        int rightY = DISPLAY_CENTER_Y - 35 - (int)((progress / 0.5f) * DISPLAY_HEIGHT);
-        if (rightY > -80 && rightY < DISPLAY_HEIGHT)
+        // 左目（10の位）・右目（1の位）の数字が上に流れる
+        int y = Layout::DIGIT_Y - (int)((progress / 0.5f) * Layout::DISPLAY_HEIGHT);
+        if (y > -Layout::DIGIT_HEIGHT && y < Layout::DISPLAY_HEIGHT)
         {
-          eyesSprite.setCursor(DISPLAY_CENTER_X + EYE_SPACING / 2 - 30, rightY);
-          eyesSprite.printf("%d", ones);
+          rasterDigit<Layout>(target, Layout::LEFT_DIGIT_X, y, state.slotNumber / 10);
+          rasterDigit<Layout>(target, Layout::RIGHT_DIGIT_X, y, state.slotNumber % 10);
         }
       }
       // 後半で目が上から流れてきて中央で止まる
-      else if (progress >= 0.5f)
+      else
       {                                               // 後半50%で目が現れる（オーバーラップなし）
         float eyeProgress = (progress - 0.5f) / 0.5f; // 0.0～1.0に正規化
 
@@ -476,480 +1324,500 @@ void drawSlotMachine()
         int eyeY;
         if (eyeProgress < 0.8f)
         { // 最初の80%で上から中央に移動
-          eyeY = -SQUARE_EYE_HEIGHT + (int)((DISPLAY_CENTER_Y - SQUARE_EYE_HEIGHT / 2 + SQUARE_EYE_HEIGHT) * eyeProgress / 0.8f);
+          eyeY = -Layout::SQUARE_EYE_HEIGHT + (int)((Layout::EYE_Y + Layout::SQUARE_EYE_HEIGHT) * eyeProgress / 0.8f);
         }
         else
         {
           // 残りの20%は中央で停止
-          eyeY = DISPLAY_CENTER_Y - SQUARE_EYE_HEIGHT / 2;
+          eyeY = Layout::EYE_Y;
         }
 
-        int leftEyeX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-        int rightEyeX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
+        int leftEyeX = Layout::LEFT_EYE_X;
+        int rightEyeX = Layout::RIGHT_EYE_X;
 
         // 画面内にある場合のみ描画
-        if (eyeY > -SQUARE_EYE_HEIGHT && eyeY < DISPLAY_HEIGHT)
+        if (eyeY > -Layout::SQUARE_EYE_HEIGHT && eyeY < Layout::DISPLAY_HEIGHT)
         {
-          eyesSprite.fillRoundRect(leftEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-          eyesSprite.fillRoundRect(rightEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
+          rasterSquareEye<Layout>(target, toSubpixel(leftEyeX), toSubpixel(eyeY));
+          rasterSquareEye<Layout>(target, toSubpixel(rightEyeX), toSubpixel(eyeY));
         }
       }
     }
     else
     {
       // 終了後は通常の目を中央に表示したまま待機
-      int leftEyeX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      int rightEyeX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      int eyeY = DISPLAY_CENTER_Y - SQUARE_EYE_HEIGHT / 2;
+      int leftEyeX = Layout::LEFT_EYE_X;
+      int rightEyeX = Layout::RIGHT_EYE_X;
+      int eyeY = Layout::EYE_Y;
 
-      eyesSprite.fillRoundRect(leftEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-      eyesSprite.fillRoundRect(rightEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
+      rasterSquareEye<Layout>(target, toSubpixel(leftEyeX), toSubpixel(eyeY));
+      rasterSquareEye<Layout>(target, toSubpixel(rightEyeX), toSubpixel(eyeY));
     }
     break;
   }
-
-  // スプライトを画面に転送
-  eyesSprite.pushSprite(&ExtDisplay, 0, 0);
 }
 
 // おやすみモードを描画する関数
-void drawSleepMode()
+template <typename Layout>
+void rasterSleepMode(const FrameSnapshot &frame, RenderTarget &target)
 {
-  unsigned long currentTime = millis();
-  unsigned long elapsedTime = currentTime - eyeState.sleepStartTime;
-
   // 背景を黒で塗りつぶし
-  eyesSprite.fillScreen(TFT_BLACK);
-
-  // 線を描画するための変数を事前に宣言
-  int leftStartX, leftEndX, rightStartX, rightEndX, lineY;
+  target.fillScreen(TFT_BLACK);
 
   // おやすみモードの状態に応じて描画
-  switch (eyeState.sleepState)
+  switch (frame.state.sleepState)
   {
-  case SLEEP_START:
-    // 開始状態：通常の目から開始
-    eyeState.sleepState = SLEEP_NORMAL;
-    eyeState.sleepStartTime = currentTime;
-    eyeState.brightness = 200; // 初期の明るさ
-    break;
-
   case SLEEP_NORMAL:
     // 通常の四角い目を3秒間表示
     // 左右の目の白目部分を描画（四角形）
     {
-      int leftEyeX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      int rightEyeX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      int eyeY = DISPLAY_CENTER_Y - SQUARE_EYE_HEIGHT / 2;
+      int leftEyeX = Layout::LEFT_EYE_X;
+      int rightEyeX = Layout::RIGHT_EYE_X;
+      int eyeY = Layout::EYE_Y;
 
       // 角丸四角形で目を描画
-      eyesSprite.fillRoundRect(leftEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-      eyesSprite.fillRoundRect(rightEyeX, eyeY, SQUARE_EYE_WIDTH, SQUARE_EYE_HEIGHT, SQUARE_EYE_RADIUS, SQUARE_EYE_COLOR);
-    }
-
-    // 3秒後に次の状態へ
-    if (elapsedTime > 3000)
-    {
-      eyeState.sleepState = SLEEP_CLOSING;
-      eyeState.sleepStartTime = currentTime;
+      rasterSquareEye<Layout>(target, toSubpixel(leftEyeX), toSubpixel(eyeY));
+      rasterSquareEye<Layout>(target, toSubpixel(rightEyeX), toSubpixel(eyeY));
     }
     break;
 
   case SLEEP_CLOSING:
-    // 目を閉じる：瞬きと同じ表現
-    // 左右の目の線を描画
-    leftStartX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-    leftEndX = leftStartX + SQUARE_EYE_WIDTH;
-    rightStartX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-    rightEndX = rightStartX + SQUARE_EYE_WIDTH;
-    lineY = DISPLAY_CENTER_Y;
-
-    // 画面からはみ出さないように制限
-    leftStartX = constrain(leftStartX, 0, DISPLAY_WIDTH - 1);
-    leftEndX = constrain(leftEndX, 0, DISPLAY_WIDTH - 1);
-    rightStartX = constrain(rightStartX, 0, DISPLAY_WIDTH - 1);
-    rightEndX = constrain(rightEndX, 0, DISPLAY_WIDTH - 1);
-
-    // 3ピクセルの太さの線を描画（中央と上下に1ピクセルずつ）
-    for (int i = -1; i <= 1; i++)
-    {
-      int y = lineY + i;
-      if (y >= 0 && y < DISPLAY_HEIGHT)
-      {
-        eyesSprite.drawLine(leftStartX, y, leftEndX, y, SQUARE_EYE_COLOR);
-        eyesSprite.drawLine(rightStartX, y, rightEndX, y, SQUARE_EYE_COLOR);
-      }
-    }
-
-    // 0.5秒後に次の状態へ
-    if (elapsedTime > 500)
-    {
-      eyeState.sleepState = SLEEP_DIMMING;
-      eyeState.sleepStartTime = currentTime;
-    }
+  {
+    // 目を閉じる：前半で眠そうな目になり、後半でまぶたを閉じる
+    unsigned long elapsedTime = frame.time - frame.state.sleepStartTime;
+    int progress = min(elapsedTime, 500UL) * 2 * MORPH_ONE / 500;
+    EyeMorph morph = {EXPRESSION_OPEN, EXPRESSION_SLEEPY, min(progress, MORPH_ONE), max(progress - MORPH_ONE, 0)};
+    EyeOutlines<Layout>::raster(target, toSubpixel(Layout::LEFT_EYE_X), toSubpixel(Layout::EYE_Y), morph, false);
+    EyeOutlines<Layout>::raster(target, toSubpixel(Layout::RIGHT_EYE_X), toSubpixel(Layout::EYE_Y), morph, true);
     break;
+  }
 
   case SLEEP_DIMMING:
-    // 画面を徐々に暗くする（2秒かけて）
-    if (elapsedTime < 2000)
-    {
-      // 左右の目の線を描画（そのまま表示）
-      leftStartX = DISPLAY_CENTER_X - EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      leftEndX = leftStartX + SQUARE_EYE_WIDTH;
-      rightStartX = DISPLAY_CENTER_X + EYE_SPACING / 2 - SQUARE_EYE_WIDTH / 2;
-      rightEndX = rightStartX + SQUARE_EYE_WIDTH;
-      lineY = DISPLAY_CENTER_Y;
-
-      leftStartX = constrain(leftStartX, 0, DISPLAY_WIDTH - 1);
-      leftEndX = constrain(leftEndX, 0, DISPLAY_WIDTH - 1);
-      rightStartX = constrain(rightStartX, 0, DISPLAY_WIDTH - 1);
-      rightEndX = constrain(rightEndX, 0, DISPLAY_WIDTH - 1);
-
-      // 3ピクセルの太さの線を描画（中央と上下に1ピクセルずつ）
-      for (int i = -1; i <= 1; i++)
-      {
-        int y = lineY + i;
-        if (y >= 0 && y < DISPLAY_HEIGHT)
-        {
-          eyesSprite.drawLine(leftStartX, y, leftEndX, y, SQUARE_EYE_COLOR);
-          eyesSprite.drawLine(rightStartX, y, rightEndX, y, SQUARE_EYE_COLOR);
-        }
-      }
-
-      // 明るさを徐々に下げる
-      eyeState.brightness = 200 - (int)(200.0 * elapsedTime / 2000.0);
-      ExtDisplay.setBrightness(eyeState.brightness);
-    }
-    else
-    {
-      // 完全に暗くなったら次の状態へ
-      eyeState.sleepState = SLEEP_COMPLETE;
-      eyeState.sleepStartTime = currentTime;
-      ExtDisplay.setBrightness(0); // 完全に暗く
-    }
+  {
+    // 閉じた目のまま暗くする
+    EyeMorph morph = {EXPRESSION_CLOSED, EXPRESSION_CLOSED, MORPH_ONE, 0};
+    EyeOutlines<Layout>::raster(target, toSubpixel(Layout::LEFT_EYE_X), toSubpixel(Layout::EYE_Y), morph, false);
+    EyeOutlines<Layout>::raster(target, toSubpixel(Layout::RIGHT_EYE_X), toSubpixel(Layout::EYE_Y), morph, true);
     break;
+  }
 
+  case SLEEP_START:
   case SLEEP_COMPLETE:
     // 完全に暗くなった状態（何も表示しない）
-    // 次のモード切替まで待機
     break;
   }
-
-  // スプライトを画面に転送
-  eyesSprite.pushSprite(&ExtDisplay, 0, 0);
 }
 
-// モードを更新する関数
-void updateMode()
+// 目のセットの状態を1フレーム分進め、描き直しが必要なセットがあればまとめて描画する
+void updateEyeSets()
 {
-  unsigned long currentTime = millis();
-
-  // モード開始時間が設定されていない場合は初期化
-  if (eyeState.modeStartTime == 0)
+  bool stale = false;
+  for (int i = 0; i < EYE_SET_COUNT; i++)
   {
-    eyeState.modeStartTime = currentTime;
-    return;
+    EyeInstance &instance = eyeInstances[i];
+    unsigned long start = micros();
+    uint8_t events = eyeSetUpdate(instance.set);
+    instance.updateMicros += micros() - start;
+    handleEyeSetEvents(i, events);
+
+    // 変化があったときだけ描き直す（ほかのモードから戻った直後と、そのトランジション中も描き直す）
+    if ((events & EYE_SET_REDRAW) || instance.transition.active || instance.shownMode != instance.set.state.mode)
+    {
+      instance.staleTargets = (1 << renderTargetCount()) - 1;
+    }
+    stale = stale || instance.staleTargets != 0;
   }
-
-  // 現在のモードに応じた持続時間を取得
-  unsigned long modeDuration;
-  switch (eyeState.mode)
+  if (stale)
   {
-  case NORMAL_EYE:
-    modeDuration = NORMAL_EYE_DURATION;
-    break;
-  case SLOT_MACHINE:
-    modeDuration = SLOT_MACHINE_DURATION;
-    break;
-  case SLEEP_MODE:
-    modeDuration = SLEEP_MODE_DURATION;
-    break;
-  default:
-    modeDuration = NORMAL_EYE_DURATION;
-    break;
+    drawEyeSets();
   }
+}
 
-  // スロットマシンとおやすみモードは時間経過で通常モードに戻る
-  EyeMode previousMode = eyeState.mode;
-  if ((previousMode == SLOT_MACHINE || previousMode == SLEEP_MODE) &&
-      currentTime - eyeState.modeStartTime >= modeDuration)
+// 目のセットで起きたことをトレースとバックライトに反映する
+// トレースには先頭のセットのモード遷移だけを記録する（ほかのセットも同じ入力と乱数列で再現できる）。
+void handleEyeSetEvents(int set, uint8_t events)
+{
+  const EyeState &state = eyeInstances[set].set.state;
+  if ((events & EYE_SET_MODE_CHANGED) && set == 0)
   {
-    // 通常モードに戻る
-    eyeState.mode = NORMAL_EYE;
-    eyeState.modeStartTime = currentTime;
-
-    // モードシーケンスを適切に進める
-    if (previousMode == SLOT_MACHINE)
-    {
-      // スロットマシンモードが終わったら、次の標準モード（2）に進める
-      eyeState.modeSequence = 2;
-    }
-    else if (previousMode == SLEEP_MODE)
-    {
-      // おやすみモードが終わったら、最初の標準モード（0）に戻す
-      eyeState.modeSequence = 0;
-    }
-
-    // 通常モードに戻る時は明るさを元に戻す
-    ExtDisplay.setBrightness(200);
+    traceModeChange(state.mode, state.modeSequence);
+  }
+  if (events & EYE_SET_BRIGHTNESS_CHANGED)
+  {
+    updateBrightness();
   }
 }
 
-// 目の位置を更新する関数
-void updateEyePosition()
+// バックライトはすべてのセットで共有なので、いちばん明るいセットに合わせる
+void updateBrightness()
 {
-  unsigned long currentTime = millis();
-
-  // モードの更新
-  updateMode();
-
-  // 通常モードの場合のみ瞬きと目の動きを更新
-  if (eyeState.mode == NORMAL_EYE)
+  int brightness = 0;
+  for (int i = 0; i < EYE_SET_COUNT; i++)
   {
-    // 瞬き処理
-    // 瞬きの開始判定
-    if (!eyeState.isBlinking && currentTime >= eyeState.nextBlinkTime)
-    {
-      eyeState.isBlinking = true;
-      eyeState.blinkStartTime = currentTime;
-      // 瞬きの持続時間は固定で0.2秒、次の瞬きは3秒後
-      eyeState.nextBlinkTime = currentTime + BLINK_DURATION + BLINK_INTERVAL;
-    }
-
-    // 瞬きの終了判定（0.2秒で確実に終了）
-    if (eyeState.isBlinking && (currentTime - eyeState.blinkStartTime >= BLINK_DURATION))
-    {
-      eyeState.isBlinking = false;
-      // 瞬きが終わったら強制的に再描画して元の目に戻す
-      drawEyes(eyeState.leftEye, eyeState.rightEye);
-    }
-
-    // 動きの開始判定
-    if (!eyeState.isMoving && currentTime >= eyeState.nextMoveTime)
-    {
-      eyeState.isMoving = true;
-      eyeState.moveStartTime = currentTime;
-
-      // 元の位置を保存
-      eyeState.originalLeft = eyeState.leftEye;
-      eyeState.originalRight = eyeState.rightEye;
+    brightness = max(brightness, eyeInstances[i].set.state.brightness);
+  }
+  ExtDisplay.setBrightness(brightness);
+}
 
-      // センターを見ているかどうかで目標位置を決定
-      if (eyeState.lookingAtCenter)
-      {
-        // センターを見ている場合は、ランダムな位置に移動
-        int maxMove = SQUARE_EYE_WIDTH / 4; // 移動範囲を制限
+// ライトをGPIOのON/OFFで制御する関数
+void updateGpioLights(bool touch1Detected, bool touch2Detected, bool touch4Detected, unsigned long currentTime)
+{
+  // タッチ1（ウィンカー）の処理
+  // タッチ中は点滅させ、離したらOFFにする
+  if (winkerUpdate(winkerState, touch1Detected, currentTime))
+  {
+    digitalWrite(PIN_WINKER_R, winkerState.on ? HIGH : LOW);
+    digitalWrite(PIN_WINKER_L, winkerState.on ? HIGH : LOW);
+  }
 
-        eyeState.targetLeft.x = random(-maxMove, maxMove + 1);
-        eyeState.targetLeft.y = random(-maxMove, maxMove + 1);
-        eyeState.targetRight.x = eyeState.targetLeft.x; // 両目を同じ方向に動かす
-        eyeState.targetRight.y = eyeState.targetLeft.y;
+  // タッチ2（ヘッドライト）の処理
+  // タッチ中はOFF、タッチしていない時はON
+  digitalWrite(PIN_HEAD, touch2Detected ? LOW : HIGH);
 
-        // 次はセンターに戻る
-        eyeState.lookingAtCenter = false;
-      }
-      else
-      {
-        // センターを見ていない場合は、センターに戻る
-        eyeState.targetLeft.x = 0;
-        eyeState.targetLeft.y = 0;
-        eyeState.targetRight.x = 0;
-        eyeState.targetRight.y = 0;
-
-        // 次はランダムな位置に移動
-        eyeState.lookingAtCenter = true;
-      }
+  // タッチ4（ブレーキライト）の処理
+  // タッチ中はOFF、タッチしていない時はON
+  digitalWrite(PIN_BRAKE, touch4Detected ? LOW : HIGH);
+}
 
-      // 次の動きの時間を設定（3秒後）
-      eyeState.nextMoveTime = currentTime + MOVE_DURATION + 3000;
-    }
+// ライトをLEDテープのパターンで制御する関数
+// タッチに応じてパターンを切り替えるだけで、送信はRMTに任せる
+void updateStripLights(bool touch1Detected, bool touch2Detected, bool touch4Detected, unsigned long currentTime)
+{
+  // タッチ1（ウィンカー）：タッチ中は左右とも点滅パターン
+  lightSetPattern(LIGHT_WINKER_R, touch1Detected ? WINKER_PATTERN : PATTERN_OFF, currentTime);
+  lightSetPattern(LIGHT_WINKER_L, touch1Detected ? WINKER_PATTERN : PATTERN_OFF, currentTime);
 
-    // 動きの処理
-    if (eyeState.isMoving)
-    {
-      unsigned long elapsedTime = currentTime - eyeState.moveStartTime;
+  // タッチ2（ヘッドライト）・タッチ4（ブレーキライト）：タッチ中はOFF、タッチしていない時はON
+  lightSetPattern(LIGHT_HEAD, touch2Detected ? PATTERN_OFF : PATTERN_HEADLIGHT_FADEIN, currentTime);
+  lightSetPattern(LIGHT_BRAKE, touch4Detected ? PATTERN_OFF : PATTERN_BRAKE_FLASH, currentTime);
 
-      if (elapsedTime >= MOVE_DURATION)
-      {
-        // 動きの終了
-        eyeState.isMoving = false;
-        eyeState.leftEye = eyeState.targetLeft;
-        eyeState.rightEye = eyeState.targetRight;
-      }
-      else
-      {
-        // 動きの途中（線形補間）
-        float progress = (float)elapsedTime / MOVE_DURATION;
+  // パターンを進め、表示が変わったLEDテープだけ送信する
+  lightUpdate(currentTime);
+}
 
-        eyeState.leftEye.x = eyeState.originalLeft.x + (eyeState.targetLeft.x - eyeState.originalLeft.x) * progress;
-        eyeState.leftEye.y = eyeState.originalLeft.y + (eyeState.targetLeft.y - eyeState.originalLeft.y) * progress;
+// ウィンカーを制御する関数
+void updateWinkers()
+{
+  // 各タッチセンサーの状態を読み取る（エッジはトレースに記録され、再生中は記録された入力に置き換わる）
+  bool touches[TRACE_TOUCH_COUNT];
+  touches[0] = traceTouch(0, digitalRead(PIN_TOUCH1) == HIGH); // ウィンカー用
+  touches[1] = traceTouch(1, digitalRead(PIN_TOUCH2) == HIGH); // ヘッドライト用
+  touches[2] = traceTouch(2, digitalRead(PIN_TOUCH3) == HIGH); // 目のモード切り替え用
+  touches[3] = traceTouch(3, digitalRead(PIN_TOUCH4) == HIGH); // ブレーキライト用
+  bool touch1Detected = touches[0];
+  bool touch2Detected = touches[1];
+  bool touch4Detected = touches[3];
 
-        eyeState.rightEye.x = eyeState.originalRight.x + (eyeState.targetRight.x - eyeState.originalRight.x) * progress;
-        eyeState.rightEye.y = eyeState.originalRight.y + (eyeState.targetRight.y - eyeState.originalRight.y) * progress;
-      }
+  // 現在の時間を取得
+  unsigned long currentTime = clockMillis();
 
-      // 目を更新
-      drawEyes(eyeState.leftEye, eyeState.rightEye);
-    }
-    else if (eyeState.isBlinking)
-    {
-      // 瞬き中は常に再描画
-      drawEyes(eyeState.leftEye, eyeState.rightEye);
-    }
+  // ライトの出力
+  if (LIGHT_OUTPUT == LIGHT_OUTPUT_STRIP)
+  {
+    updateStripLights(touch1Detected, touch2Detected, touch4Detected, currentTime);
   }
   else
   {
-    // 他のモードの場合は常に再描画
-    drawEyes(eyeState.leftEye, eyeState.rightEye);
+    updateGpioLights(touch1Detected, touch2Detected, touch4Detected, currentTime);
+  }
+
+  // 目のモード切り替えの処理（セットごとに割り当てたタッチで切り替える）
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    handleEyeSetEvents(i, eyeSetTouch(eyeInstances[i].set, touches));
   }
 }
 
-// ウィンカーを制御する関数
-void updateWinkers()
+// 状態機械を初期状態に戻す（起動時とトレース再生の開始時に使用）
+void resetStateMachine()
 {
-  // 各タッチセンサーの状態を読み取る
-  bool touch1Detected = digitalRead(PIN_TOUCH1) == HIGH; // ウィンカー用
-  bool touch2Detected = digitalRead(PIN_TOUCH2) == HIGH; // ヘッドライト用
-  bool touch3Detected = digitalRead(PIN_TOUCH3) == HIGH; // 目のモード切り替え用
-  bool touch4Detected = digitalRead(PIN_TOUCH4) == HIGH; // ブレーキライト用
+  // ウィンカーと目の状態を初期化
+  winkerState = {};
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    EyeInstance &instance = eyeInstances[i];
+    eyeSetReset(instance.set);
 
-  // 現在の時間を取得
-  unsigned long currentTime = millis();
+    // 描画中のトランジションは打ち切る
+    instance.transition.active = false;
+    instance.shownMode = NORMAL_EYE;
+  }
+}
 
-  // タッチ1（ウィンカー）の処理
-  if (touch1Detected)
+// 新しい乱数シードでトレースの記録を開始し、状態機械を初期化する
+// （再生時に同じ乱数列を再現できるよう、シードはトレースのヘッダに残す）
+void restartTrace()
+{
+  uint32_t seed = esp_random();
+  randomSeed(seed);
+  traceBegin(seed, clockMillis());
+  resetStateMachine();
+}
+
+// 記録したトレースを仮想クロックで再生し、フレーム処理時間を計測する
+void replayTrace()
+{
+  const TraceHeader &header = traceHeader();
+  size_t count = traceCount();
+  if (header.dropped > 0)
+  {
+    // 先頭が上書きされている場合は初期状態から近似的に再生する
+    Serial.printf("replay: %u records were dropped, replay is approximate\n", (unsigned)header.dropped);
+  }
+
+  ReplayStats stats = {};
+  unsigned long wallStart = millis();
+
+  // 記録開始時と同じ時刻・乱数シード・初期状態から開始
+  traceReplayBegin(REPLAY_FRAME_INTERVAL);
+  randomSeed(header.seed);
+  resetStateMachine();
+  ExtDisplay.setBrightness(DISPLAY_BRIGHTNESS);
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    // 目のセットごとの処理時間も再生の分だけを集計する
+    EyeInstance &instance = eyeInstances[i];
+    instance.updateMicros = 0;
+    instance.rasterMicros[0] = 0;
+    instance.rasterMicros[1] = 0;
+    instance.frames = 0;
+  }
+
+  // 1フレーム分の処理を実行して処理時間を集計する
+  auto stepFrame = [&stats](unsigned long time)
   {
-    // タッチが検出された場合、ウィンカーを点滅させる
-    if (currentTime - lastWinkerToggleTime >= WINKER_BLINK_INTERVAL)
+    clockAdvanceTo(time);
+    unsigned long start = micros();
+    updateEyeSets();
+    updateWinkers();
+    uint32_t cost = micros() - start;
+
+    stats.frames++;
+    stats.totalMicros += cost;
+    if (cost > stats.maxMicros)
     {
-      // 点滅間隔が経過したら状態を切り替え
-      winkerState = !winkerState;
-      digitalWrite(PIN_WINKER_R, winkerState ? HIGH : LOW);
-      digitalWrite(PIN_WINKER_L, winkerState ? HIGH : LOW);
-      lastWinkerToggleTime = currentTime;
+      stats.maxMicros = cost;
     }
-  }
-  else
+    int bucket = 0;
+    while (bucket < 7 && cost >= (1000u << bucket))
+    {
+      bucket++;
+    }
+    stats.histogram[bucket]++;
+  };
+
+  unsigned long time = header.startTime;
+  size_t next = 0;
+  while (next < count)
   {
-    // タッチが検出されていない場合、ウィンカーをOFFにする
-    if (winkerState)
+    // 次のレコードの時刻まで一定間隔でフレームを進める
+    unsigned long recordTime = traceAt(next).time;
+    while ((long)(recordTime - time) > REPLAY_FRAME_INTERVAL)
     {
-      digitalWrite(PIN_WINKER_R, LOW);
-      digitalWrite(PIN_WINKER_L, LOW);
-      winkerState = false;
+      time += REPLAY_FRAME_INTERVAL;
+      stepFrame(time);
     }
-  }
 
-  // タッチ2（ヘッドライト）の処理
-  // タッチ中はOFF、タッチしていない時はON
-  digitalWrite(PIN_HEAD, touch2Detected ? LOW : HIGH);
+    // 同じ時刻のタッチエッジをまとめて注入し、その時刻ちょうどのフレームを実行
+    time = recordTime;
+    while (next < count && traceAt(next).time == recordTime)
+    {
+      traceReplayInject(traceAt(next));
+      next++;
+    }
+    stepFrame(time);
+  }
 
-  // タッチ4（ブレーキライト）の処理
-  // タッチ中はOFF、タッチしていない時はON
-  digitalWrite(PIN_BRAKE, touch4Detected ? LOW : HIGH);
+  stats.virtualMillis = time - header.startTime;
+  stats.divergences = traceReplayEnd();
+  stats.wallMillis = millis() - wallStart;
 
-  // タッチ3（目のモード切り替え）の処理
-  if (touch3Detected && !eyeState.touch3Pressed)
+  Serial.printf("replay: %u records, %u frames, virtual %u ms, wall %u ms\n",
+                (unsigned)count, (unsigned)stats.frames, (unsigned)stats.virtualMillis, (unsigned)stats.wallMillis);
+  Serial.printf("replay: frame avg %u us, max %u us, mode divergences %u\n",
+                (unsigned)(stats.frames ? stats.totalMicros / stats.frames : 0), (unsigned)stats.maxMicros,
+                (unsigned)stats.divergences);
+  for (int i = 0; i < 7; i++)
   {
-    // タッチ3が押された瞬間
-    eyeState.touch3Pressed = true;
-    eyeState.touch3Time = currentTime;
+    Serial.printf("replay: < %2u ms %u\n", 1u << i, (unsigned)stats.histogram[i]);
   }
-  else if (!touch3Detected && eyeState.touch3Pressed)
+  Serial.printf("replay: >=64 ms %u\n", (unsigned)stats.histogram[7]);
+  for (int i = 0; i < EYE_SET_COUNT; i++)
   {
-    // タッチ3が離された瞬間
-    eyeState.touch3Pressed = false;
-    eyeState.touch3Released = true;
+    // 状態の更新は全フレーム、ラスタライズは描いたフレームあたり（2コア描画では2つのターゲットの合計）
+    const EyeInstance &instance = eyeInstances[i];
+    uint32_t raster = instance.rasterMicros[0] + instance.rasterMicros[1];
+    Serial.printf("replay: set %d update avg %u us, raster avg %u us, %u frames\n", i,
+                  (unsigned)(stats.frames ? instance.updateMicros / stats.frames : 0),
+                  (unsigned)(instance.frames ? raster / instance.frames : 0), (unsigned)instance.frames);
   }
 
-  // タッチ3が離された後の処理
-  if (eyeState.touch3Released)
-  {
-    eyeState.touch3Released = false;
+  // 再生後は新しいシードで記録を再開する
+  restartTrace();
+}
 
-    // モードシーケンスを進める（0: 通常, 1: スロット, 2: 通常, 3: おやすみ）
-    eyeState.modeSequence = (eyeState.modeSequence + 1) % 4;
+// シリアルコマンドを処理する
+// d: トレースをバイナリでダンプ, l: トレースを読み込み, p: トレースを再生, r: 記録を再開
+// c: フレームのキャッシュの統計を出力, m: メモリの状態を出力, v: フレームのライブストリームを開始／停止
+// o: 描画量の計測を開始／停止（停止時に区分ごとの統計とヒートマップを出力）
+void handleSerialCommand()
+{
+  if (Serial.available() <= 0)
+  {
+    return;
+  }
 
-    // シーケンスに応じてモードを設定
-    switch (eyeState.modeSequence)
+  switch (Serial.read())
+  {
+  case 'd':
+    traceDump(Serial);
+    break;
+  case 'l':
+    Serial.println(traceLoad(Serial) ? "load: ok" : "load: failed");
+    break;
+  case 'c':
+  {
+    FrameCacheStats stats = frameCacheStats();
+    Serial.printf("cache: %u lookups, %u hits (%u%%), %u inserts, %u evictions, %u rejected, %d entries, %u/%u bytes\n",
+                  (unsigned)stats.lookups, (unsigned)stats.hits,
+                  (unsigned)(stats.lookups ? (uint64_t)stats.hits * 100 / stats.lookups : 0),
+                  (unsigned)stats.inserts, (unsigned)stats.evictions, (unsigned)stats.rejected, stats.entries,
+                  (unsigned)stats.bytes, (unsigned)stats.capacity);
+    break;
+  }
+  case 'm':
+    reportMemory();
+    break;
+  case 'o':
+    if (overdrawEnabled())
     {
-    case 0: // 通常モード
-    case 2: // 通常モード（2回目）
-      eyeState.mode = NORMAL_EYE;
-      break;
-    case 1: // スロットマシンモード
-      eyeState.mode = SLOT_MACHINE;
-      eyeState.slotState = SLOT_START;
-      break;
-    case 3: // おやすみモード
-      eyeState.mode = SLEEP_MODE;
-      eyeState.sleepState = SLEEP_START;
-      break;
+      overdrawStop();
+      overdrawReport(Serial);
     }
-
-    // モード開始時間をリセット
-    eyeState.modeStartTime = currentTime;
-
-    // モード固有の初期化
-    if (eyeState.mode == SLOT_MACHINE)
+    else
     {
-      eyeState.slotStartTime = currentTime;
+      // 交互描画で描いている途中のフレームを待ってから計測を始める
+      rasterWorkerJoin();
+      bool started = overdrawBegin(ActivePanel::DISPLAY_WIDTH, ActivePanel::DISPLAY_HEIGHT, framebufferPixels(),
+                                   OVERDRAW_BUCKET_NAMES, OVERDRAW_BUCKET_COUNT);
+      Serial.println(started ? "overdraw: started" : "overdraw: no memory for heatmaps");
     }
-    else if (eyeState.mode == SLEEP_MODE)
+    break;
+  case 'p':
+    replayTrace();
+    break;
+  case 'r':
+    restartTrace();
+    Serial.println("trace: restarted");
+    break;
+  case 'v':
+    frameStreamSetEnabled(!frameStreamEnabled());
+    if (!frameStreamEnabled())
     {
-      eyeState.sleepStartTime = currentTime;
+      const FrameStreamStats &stats = frameStreamStats();
+      Serial.printf("\nstream: %u frames, %u skipped, %u bytes, encode avg %u us, max %u us\n",
+                    (unsigned)stats.frames, (unsigned)stats.skipped, (unsigned)stats.bytes,
+                    (unsigned)(stats.frames ? stats.encodeMicros / stats.frames : 0), (unsigned)stats.maxMicros);
     }
+    break;
+  default:
+    break;
+  }
+}
+
+// メモリの状態を出力する
+void reportMemory()
+{
+  switch (frameBufferPlan)
+  {
+  case FRAME_BUFFERS_BANDED:
+    Serial.printf("memory: framebuffers did not fit, drawing in %d-line bands\n", BAND_HEIGHT);
+    break;
+  case FRAME_BUFFERS_NONE:
+    Serial.println("memory: no framebuffer, drawing disabled");
+    break;
+  default:
+    break;
   }
+  memoryPlanReport(Serial);
+}
+
+// 目のセットの時刻の取得元（トレースの再生中は仮想クロック）
+uint32_t eyeClock()
+{
+  return clockMillis();
 }
 
 void setup()
 {
+  // フレームバッファはヒープが断片化する前に最初に確保する
+  reserveFrameBuffers<ActivePanel>();
+
   M5.begin();
-  // Serial.begin();
+  Serial.setTxBufferSize(4096); // ライブストリーム用に送信バッファを広げる
+  Serial.begin(115200);
+  Serial.setTxTimeoutMs(0);     // ホストが読んでいなくても描画を止めない
+  Serial.setTimeout(1000); // トレース読み込みのタイムアウト
   ExtDisplay.init();             // 外部ディスプレイを初期化
-  ExtDisplay.setBrightness(200); // バックライトの明るさ(0-255)
+  ExtDisplay.setBrightness(DISPLAY_BRIGHTNESS); // バックライトの明るさ(0-255)
+  if constexpr (ActivePanel::PANEL_COUNT > 1)
+  {
+    // 右目用のパネルを初期化（リセットは左目用のパネルの初期化で済んでいる）
+    rightDisplay<ActivePanel>().init();
+  }
 
   // ピンの初期化
-  pinMode(PIN_WINKER_R, OUTPUT);
-  pinMode(PIN_WINKER_L, OUTPUT);
   pinMode(PIN_TOUCH1, INPUT);
   pinMode(PIN_TOUCH2, INPUT);
   pinMode(PIN_TOUCH3, INPUT);
-  pinMode(PIN_TOUCH4, INPUT);    // タッチ4を入力として初期化
-  pinMode(PIN_HEAD, OUTPUT);
-  pinMode(PIN_BRAKE, OUTPUT);
-
-  // 出力ピンの初期状態を設定
-  digitalWrite(PIN_WINKER_R, LOW);
-  digitalWrite(PIN_WINKER_L, LOW);
-  digitalWrite(PIN_HEAD, HIGH);  // 初期状態はHIGH
-  digitalWrite(PIN_BRAKE, HIGH); // 初期状態はHIGH
-
-  // 目の初期状態を設定
-  eyeState.leftEye = {0, 0};
-  eyeState.rightEye = {0, 0};
-  eyeState.prevLeftEye = {0, 0};
-  eyeState.prevRightEye = {0, 0};
-  eyeState.isMoving = false;
-  eyeState.initialized = false;
-  eyeState.nextMoveTime = millis() + random(MOVE_INTERVAL_MIN, MOVE_INTERVAL_MAX + 1);
-  eyeState.mode = NORMAL_EYE; // 初期モードは通常の目
-  eyeState.isBlinking = false;
-  eyeState.nextBlinkTime = millis() + BLINK_INTERVAL;
-  eyeState.lookingAtCenter = true; // 初期状態はセンターを見ている
-  eyeState.modeStartTime = 0;      // モード開始時間（updateMode()で初期化される）
-  eyeState.touch3Pressed = false;
-  eyeState.touch3Released = false;
-  eyeState.modeSequence = 0;
+  pinMode(PIN_TOUCH4, INPUT); // タッチ4を入力として初期化
+
+  if (LIGHT_OUTPUT == LIGHT_OUTPUT_STRIP)
+  {
+    // LEDテープはRMTのチャンネルにつなぐ（LightChannelの順）
+    const int lightPins[LIGHT_CHANNEL_COUNT] = {PIN_WINKER_R, PIN_WINKER_L, PIN_HEAD, PIN_BRAKE};
+    lightSequencerBegin(lightPins);
+  }
+  else
+  {
+    pinMode(PIN_WINKER_R, OUTPUT);
+    pinMode(PIN_WINKER_L, OUTPUT);
+    pinMode(PIN_HEAD, OUTPUT);
+    pinMode(PIN_BRAKE, OUTPUT);
+
+    // 出力ピンの初期状態を設定
+    digitalWrite(PIN_WINKER_R, LOW);
+    digitalWrite(PIN_WINKER_L, LOW);
+    digitalWrite(PIN_HEAD, HIGH);  // 初期状態はHIGH
+    digitalWrite(PIN_BRAKE, HIGH); // 初期状態はHIGH
+  }
+
+  // 目のセットごとに描く領域を割り当てる（左上から行ごとに並べる）
+  for (int i = 0; i < EYE_SET_COUNT; i++)
+  {
+    EyeInstance &instance = eyeInstances[i];
+    instance.regionX = (i % EYE_SET_COLUMNS) * SetLayout::DISPLAY_WIDTH;
+    instance.regionY = (i / EYE_SET_COLUMNS) * SetLayout::DISPLAY_HEIGHT;
+    eyeSetBegin(instance.set, eyeClock, EYE_SET_TOUCH, SetLayout::MAX_EYE_MOVE);
+  }
+
+  // トレースの記録を開始し、目の初期状態を設定
+  restartTrace();
 
   // 初期描画
   drawInitialEyes();
+
+  // 起動時のメモリの状態を報告する
+  memoryPlanWatchTask("loop", xTaskGetCurrentTaskHandle());
+  memoryPlanWatchTask("raster", rasterWorkerTask());
+  reportMemory();
 }
 
 void loop()
 {
   M5.update();
-  updateEyePosition();
+  updateEyeSets();
   updateWinkers(); // ウィンカー制御を更新
+  handleSerialCommand();
   delay(16);       // 約60FPS
 }
@@ -0,0 +1,96 @@
+// メモリ計画
+#include "memory_plan.h"
+
+// 確保した領域
+struct MemoryBlock
+{
+  const char *name; // 用途
+  void *address;    // 先頭アドレス
+  size_t bytes;     // 大きさ（アラインメントの倍数に切り上げたもの）
+};
+
+// スタックを監視するタスク
+struct WatchedTask
+{
+  const char *name;
+  TaskHandle_t task;
+};
+
+static MemoryBlock blocks[MEMORY_PLAN_MAX_BLOCKS];
+static int blockCount = 0;
+static WatchedTask tasks[MEMORY_PLAN_MAX_TASKS];
+static int taskCount = 0;
+static const char *failedName = nullptr; // 最後に確保できなかった用途
+static size_t failedBytes = 0;           // 最後に確保できなかった大きさ
+static int failedCount = 0;              // 確保できなかった回数
+
+void *memoryPlanReserve(const char *name, size_t bytes, uint32_t caps)
+{
+  size_t size = (bytes + MEMORY_PLAN_ALIGNMENT - 1) & ~(MEMORY_PLAN_ALIGNMENT - 1);
+  void *address = blockCount < MEMORY_PLAN_MAX_BLOCKS ? heap_caps_aligned_alloc(MEMORY_PLAN_ALIGNMENT, size, caps) : nullptr;
+  if (address == nullptr)
+  {
+    failedName = name;
+    failedBytes = size;
+    failedCount++;
+    return nullptr;
+  }
+  memset(address, 0, size);
+  blocks[blockCount++] = {name, address, size};
+  return address;
+}
+
+void memoryPlanRelease(void *block)
+{
+  for (int i = 0; i < blockCount; i++)
+  {
+    if (blocks[i].address == block)
+    {
+      heap_caps_free(block);
+      blocks[i] = blocks[--blockCount];
+      return;
+    }
+  }
+}
+
+size_t memoryPlanReservedBytes()
+{
+  size_t total = 0;
+  for (int i = 0; i < blockCount; i++)
+  {
+    total += blocks[i].bytes;
+  }
+  return total;
+}
+
+void memoryPlanWatchTask(const char *name, TaskHandle_t task)
+{
+  if (task != nullptr && taskCount < MEMORY_PLAN_MAX_TASKS)
+  {
+    tasks[taskCount++] = {name, task};
+  }
+}
+
+void memoryPlanReport(Print &out)
+{
+  out.printf("memory: %u bytes reserved in %d blocks\n", (unsigned)memoryPlanReservedBytes(), blockCount);
+  for (int i = 0; i < blockCount; i++)
+  {
+    out.printf("memory:   %-8s %6u bytes at %p\n", blocks[i].name, (unsigned)blocks[i].bytes, blocks[i].address);
+  }
+  if (failedCount > 0)
+  {
+    out.printf("memory: %d reservations failed, last %s (%u bytes)\n", failedCount, failedName, (unsigned)failedBytes);
+  }
+  out.printf("memory: free heap %u bytes, largest block %u bytes, minimum free %u bytes\n",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+  out.printf("memory: internal DMA free %u bytes, largest block %u bytes\n",
+             (unsigned)heap_caps_get_free_size(MEMORY_PLAN_DMA_CAPS),
+             (unsigned)heap_caps_get_largest_free_block(MEMORY_PLAN_DMA_CAPS));
+  for (int i = 0; i < taskCount; i++)
+  {
+    out.printf("memory: stack %-8s %u bytes unused\n", tasks[i].name, (unsigned)uxTaskGetStackHighWaterMark(tasks[i].task));
+  }
+}
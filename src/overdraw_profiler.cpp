@@ -0,0 +1,213 @@
+// 描画量（オーバードロー）と転送量の計測
+#include "overdraw_profiler.h"
+#include "memory_plan.h"
+
+// 区分ごとの集計
+struct OverdrawBucketStats
+{
+  uint32_t frames;    // フレーム数
+  uint64_t writes;    // 書き込んだピクセル数（背景の塗りつぶしを含む）
+  uint64_t clears;    // 背景の塗りつぶしで書き込んだピクセル数
+  uint64_t pushed;    // 転送したピクセル数
+  uint32_t maxWrites; // 1フレームの書き込みの最大
+};
+
+enum HeatmapKind
+{
+  HEATMAP_WRITES, // 書き込み
+  HEATMAP_PUSHED, // 転送
+  HEATMAP_KIND_COUNT
+};
+
+static const char *const *names = nullptr;
+static int bucketTotal = 0;
+static int frameWidth = 0;
+static int frameHeight = 0;
+static uint32_t framebufferArea = 0; // 1フレームで描くフレームバッファのピクセル数（オーバードロー率と転送した割合の分母）
+static int cellsX = 0;
+static int cellsY = 0;
+static uint32_t *heatmaps = nullptr; // [区分][種類][マス]（マスごとのピクセル数の合計）
+static OverdrawBucketStats stats[OVERDRAW_MAX_BUCKETS];
+static bool enabled = false;
+static int currentBucket = -1;    // 計測中のフレームの区分（-1: フレームの外）
+static OverdrawBucketStats frame; // 計測中のフレームの集計
+
+bool overdrawBegin(int width, int height, uint32_t framebufferPixels, const char *const *bucketNames, int bucketCount)
+{
+  if (heatmaps == nullptr)
+  {
+    frameWidth = width;
+    frameHeight = height;
+    cellsX = (width + OVERDRAW_CELL - 1) / OVERDRAW_CELL;
+    cellsY = (height + OVERDRAW_CELL - 1) / OVERDRAW_CELL;
+    bucketTotal = min(bucketCount, OVERDRAW_MAX_BUCKETS);
+    names = bucketNames;
+    size_t bytes = (size_t)bucketTotal * HEATMAP_KIND_COUNT * cellsX * cellsY * sizeof(uint32_t);
+    heatmaps = (uint32_t *)memoryPlanReserve("overdraw", bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (heatmaps == nullptr)
+    {
+      return false;
+    }
+  }
+  memset(heatmaps, 0, (size_t)bucketTotal * HEATMAP_KIND_COUNT * cellsX * cellsY * sizeof(uint32_t));
+  memset(stats, 0, sizeof(stats));
+  framebufferArea = framebufferPixels;
+  currentBucket = -1;
+  enabled = true;
+  return true;
+}
+
+void overdrawStop()
+{
+  enabled = false;
+  currentBucket = -1;
+}
+
+bool overdrawEnabled()
+{
+  return enabled;
+}
+
+void overdrawFrameBegin(int bucket)
+{
+  if (!enabled || bucket < 0 || bucket >= bucketTotal)
+  {
+    return;
+  }
+  currentBucket = bucket;
+  frame = {};
+}
+
+void overdrawFrameEnd()
+{
+  if (currentBucket < 0)
+  {
+    return;
+  }
+  OverdrawBucketStats &bucket = stats[currentBucket];
+  bucket.frames++;
+  bucket.writes += frame.writes;
+  bucket.clears += frame.clears;
+  bucket.pushed += frame.pushed;
+  bucket.maxWrites = max(bucket.maxWrites, (uint32_t)frame.writes);
+  currentBucket = -1;
+}
+
+// 矩形をマスごとに分けてヒートマップに加える（加えたピクセル数を返す）
+static uint32_t addToHeatmap(HeatmapKind kind, int x, int y, int w, int h)
+{
+  int x0 = max(x, 0);
+  int y0 = max(y, 0);
+  int x1 = min(x + w, frameWidth);
+  int y1 = min(y + h, frameHeight);
+  if (x0 >= x1 || y0 >= y1)
+  {
+    return 0;
+  }
+  uint32_t *cells = heatmaps + ((size_t)currentBucket * HEATMAP_KIND_COUNT + kind) * cellsX * cellsY;
+  for (int cy = y0 / OVERDRAW_CELL; cy <= (y1 - 1) / OVERDRAW_CELL; cy++)
+  {
+    int rows = min(y1, (cy + 1) * OVERDRAW_CELL) - max(y0, cy * OVERDRAW_CELL);
+    for (int cx = x0 / OVERDRAW_CELL; cx <= (x1 - 1) / OVERDRAW_CELL; cx++)
+    {
+      int columns = min(x1, (cx + 1) * OVERDRAW_CELL) - max(x0, cx * OVERDRAW_CELL);
+      cells[cy * cellsX + cx] += rows * columns;
+    }
+  }
+  return (uint32_t)(x1 - x0) * (y1 - y0);
+}
+
+void overdrawCountClear(int x, int y, int w, int h)
+{
+  if (currentBucket < 0)
+  {
+    return;
+  }
+  uint32_t pixels = addToHeatmap(HEATMAP_WRITES, x, y, w, h);
+  frame.writes += pixels;
+  frame.clears += pixels;
+}
+
+void overdrawCountWrite(int x, int y, int w, int h)
+{
+  if (currentBucket < 0)
+  {
+    return;
+  }
+  frame.writes += addToHeatmap(HEATMAP_WRITES, x, y, w, h);
+}
+
+void overdrawCountPush(int x, int y, int w, int h)
+{
+  if (currentBucket < 0)
+  {
+    return;
+  }
+  frame.pushed += addToHeatmap(HEATMAP_PUSHED, x, y, w, h);
+}
+
+// 100倍した比率を「整数.小数2桁」で出力する
+static void printHundredths(Print &out, uint32_t hundredths)
+{
+  out.printf("%u.%02u", (unsigned)(hundredths / 100), (unsigned)(hundredths % 100));
+}
+
+// ヒートマップを1枚、PGM（P2）で出力する
+static void printHeatmap(Print &out, int bucket, HeatmapKind kind)
+{
+  const char *kindName = kind == HEATMAP_WRITES ? "writes" : "push";
+  const uint32_t *cells = heatmaps + ((size_t)bucket * HEATMAP_KIND_COUNT + kind) * cellsX * cellsY;
+  uint32_t frames = stats[bucket].frames;
+
+  out.printf("overdraw: image %s-%s.pgm\n", names[bucket], kindName);
+  out.printf("P2\n# %s %s, %d = once per pixel per frame, %d px cells\n%d %d\n255\n",
+             names[bucket], kindName, OVERDRAW_LEVEL_ONE, OVERDRAW_CELL, cellsX, cellsY);
+  for (int cy = 0; cy < cellsY; cy++)
+  {
+    for (int cx = 0; cx < cellsX; cx++)
+    {
+      // 画面の端のマスは画面内の部分の面積で割る
+      uint32_t area = (min(frameWidth, (cx + 1) * OVERDRAW_CELL) - cx * OVERDRAW_CELL) *
+                      (min(frameHeight, (cy + 1) * OVERDRAW_CELL) - cy * OVERDRAW_CELL);
+      uint64_t level = (uint64_t)cells[cy * cellsX + cx] * OVERDRAW_LEVEL_ONE / ((uint64_t)area * frames);
+      out.printf(cx == 0 ? "%u" : " %u", (unsigned)min(level, (uint64_t)255));
+    }
+    out.print('\n');
+  }
+}
+
+void overdrawReport(Print &out)
+{
+  if (heatmaps == nullptr)
+  {
+    out.println("overdraw: not started");
+    return;
+  }
+  out.println("overdraw: bucket frames writes/frame max-writes overdraw clear% pushed-bytes/frame pushed%");
+  for (int i = 0; i < bucketTotal; i++)
+  {
+    const OverdrawBucketStats &bucket = stats[i];
+    if (bucket.frames == 0)
+    {
+      continue;
+    }
+    out.printf("overdraw: %s %u %u %u ", names[i], (unsigned)bucket.frames, (unsigned)(bucket.writes / bucket.frames),
+               (unsigned)bucket.maxWrites);
+    // 背景を塗らずに描くフレーム（トランジションや描き直さなかった目のセット）もあるので、分母はフレームバッファの大きさにする
+    uint64_t area = (uint64_t)bucket.frames * framebufferArea;
+    printHundredths(out, area ? (uint32_t)(bucket.writes * 100 / area) : 0);
+    out.printf(" %u%% %u %u%%\n",
+               (unsigned)(bucket.writes ? bucket.clears * 100 / bucket.writes : 0),
+               (unsigned)(bucket.pushed * OVERDRAW_PANEL_BYTES / bucket.frames),
+               (unsigned)(area ? bucket.pushed * 100 / area : 0));
+  }
+  for (int i = 0; i < bucketTotal; i++)
+  {
+    if (stats[i].frames > 0)
+    {
+      printHeatmap(out, i, HEATMAP_WRITES);
+      printHeatmap(out, i, HEATMAP_PUSHED);
+    }
+  }
+  out.println("overdraw: end");
+}
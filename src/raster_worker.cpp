@@ -0,0 +1,71 @@
+// もう一方のコアでラスタライズを行うワーカー
+#include "raster_worker.h"
+
+constexpr uint32_t RASTER_WORKER_STACK = 4096; // ワーカータスクのスタックサイズ（ESP-IDFではバイト単位）
+constexpr UBaseType_t RASTER_WORKER_PRIORITY = 2;
+
+static StackType_t workerStack[RASTER_WORKER_STACK]; // ワーカータスクのスタック（静的に確保）
+static StaticTask_t workerTaskBuffer;                // ワーカータスクの管理領域
+static TaskHandle_t workerTask = nullptr;            // ワーカータスク
+static TaskHandle_t callerTask = nullptr;            // ジョブを投入したタスク（完了通知先）
+static volatile RasterJob pendingJob = nullptr;
+static void *volatile pendingContext = nullptr;
+static bool jobInFlight = false; // ジョブの完了待ち中かどうか
+
+// ワーカータスク本体：通知を受けたらジョブを実行し、投入元へ完了を通知する
+static void rasterWorkerLoop(void *)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    pendingJob(pendingContext);
+    xTaskNotifyGive(callerTask);
+  }
+}
+
+bool rasterWorkerBegin(int core)
+{
+  if (workerTask != nullptr)
+  {
+    return true;
+  }
+  workerTask = xTaskCreateStaticPinnedToCore(rasterWorkerLoop, "raster", RASTER_WORKER_STACK, nullptr,
+                                            RASTER_WORKER_PRIORITY, workerStack, &workerTaskBuffer, core);
+  return workerTask != nullptr;
+}
+
+TaskHandle_t rasterWorkerTask()
+{
+  return workerTask;
+}
+
+void rasterWorkerFork(RasterJob job, void *context)
+{
+  if (workerTask == nullptr)
+  {
+    // ワーカーが起動できなかった場合は呼び出し元で実行する
+    job(context);
+    return;
+  }
+
+  pendingJob = job;
+  pendingContext = context;
+  callerTask = xTaskGetCurrentTaskHandle();
+  jobInFlight = true;
+  xTaskNotifyGive(workerTask);
+}
+
+void rasterWorkerJoin()
+{
+  if (!jobInFlight)
+  {
+    return;
+  }
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  jobInFlight = false;
+}
+
+bool rasterWorkerBusy()
+{
+  return jobInFlight;
+}
@@ -0,0 +1,266 @@
+// モード切り替えのトランジション
+#include "transition.h"
+#include "memory_plan.h"
+
+constexpr size_t RUN_BYTES = 4;                // ラン1つのバイト数
+constexpr uint32_t RGB565_SPREAD = 0x07E0F81F; // 3成分を32bitに広げたときのマスク（g:21-26, r:11-15, b:0-4）
+
+static_assert(TRANSITION_BYTES <= UINT16_MAX, "snapshots use 16-bit offsets");
+
+// 4x4の順序ディザの閾値（ディゾルブで入れ替える順番）
+static const uint8_t DISSOLVE_ORDER[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5}};
+
+// 取っておいたフレーム（範囲の外は黒）
+struct Snapshot
+{
+  DirtyRect rect;  // 描画した範囲（描画の座標）
+  uint16_t offset; // 領域の中の位置
+  uint16_t bytes;  // 圧縮したランの大きさ
+};
+
+// グループごとの領域とスナップショット
+struct SnapshotGroup
+{
+  size_t offset;                           // 領域の中のグループの先頭
+  size_t used;                             // 使用中のバイト数
+  Snapshot fromFrames[TRANSITION_TARGETS]; // 切り替え前のフレーム（ターゲットごと）
+  Snapshot toFrames[TRANSITION_TARGETS];   // 切り替え先のフレーム（ターゲットごと）
+};
+
+static uint8_t *arena = nullptr;
+static size_t groupBytes = 0; // グループごとの領域の大きさ
+static int wipeWidth = 0;     // ワイプで境目が横切る幅
+static SnapshotGroup groups[TRANSITION_GROUPS];
+
+bool transitionBegin(int frameWidth, int groupCount)
+{
+  wipeWidth = frameWidth + TRANSITION_WIPE_EDGE;
+  groupBytes = TRANSITION_BYTES / groupCount / RUN_BYTES * RUN_BYTES;
+  if (arena == nullptr)
+  {
+    arena = (uint8_t *)memoryPlanReserve("transition", TRANSITION_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  for (int i = 0; i < groupCount; i++)
+  {
+    groups[i].offset = i * groupBytes;
+    transitionReset(i);
+  }
+  return arena != nullptr;
+}
+
+void transitionReset(int group)
+{
+  SnapshotGroup &snapshots = groups[group];
+  snapshots.used = 0;
+  for (int i = 0; i < TRANSITION_TARGETS; i++)
+  {
+    snapshots.fromFrames[i] = {};
+    snapshots.toFrames[i] = {};
+  }
+}
+
+static bool pushRun(SnapshotGroup &snapshots, uint16_t count, uint16_t value)
+{
+  if (snapshots.used + RUN_BYTES > groupBytes)
+  {
+    return false;
+  }
+  uint8_t *run = arena + snapshots.offset + snapshots.used;
+  memcpy(run, &count, 2);
+  memcpy(run + 2, &value, 2);
+  snapshots.used += RUN_BYTES;
+  return true;
+}
+
+// 描画した範囲のピクセルを行ごとのランにしてグループの領域の後ろに足す
+static bool capture(const RenderTarget &target, SnapshotGroup &snapshots, Snapshot &snapshot)
+{
+  if (arena == nullptr || target.sprite->getColorDepth() != 16)
+  {
+    return false;
+  }
+  const DirtyRect &drawn = target.drawn;
+  snapshot = {drawn, (uint16_t)(snapshots.offset + snapshots.used), 0};
+  if (drawn.empty())
+  {
+    return true;
+  }
+  int stride = target.width();
+  const uint16_t *pixels = static_cast<const uint16_t *>(target.sprite->getBuffer());
+  for (int y = drawn.y0; y < drawn.y1; y++)
+  {
+    const uint16_t *row = pixels + (y - target.originY) * stride - target.originX;
+    uint16_t runValue = row[drawn.x0];
+    uint16_t runCount = 0;
+    for (int x = drawn.x0; x < drawn.x1; x++)
+    {
+      if (row[x] != runValue)
+      {
+        if (!pushRun(snapshots, runCount, runValue))
+        {
+          return false;
+        }
+        runValue = row[x];
+        runCount = 0;
+      }
+      runCount++;
+    }
+    if (!pushRun(snapshots, runCount, runValue))
+    {
+      return false;
+    }
+  }
+  snapshot.bytes = (uint16_t)(snapshots.offset + snapshots.used - snapshot.offset);
+  return true;
+}
+
+bool transitionCaptureFrom(int group, int slot, const RenderTarget &target)
+{
+  return capture(target, groups[group], groups[group].fromFrames[slot]);
+}
+
+bool transitionCaptureTo(int group, int slot, const RenderTarget &target)
+{
+  return capture(target, groups[group], groups[group].toFrames[slot]);
+}
+
+// スナップショットを行の順に読み進める
+// 範囲の外は黒の区間として返すので、2つのフレームを同じ行・同じ位置から並べて読める。
+struct SnapshotCursor
+{
+  const Snapshot &snapshot;
+  const uint8_t *run; // 次に読むラン
+  uint16_t left;      // 読みかけのランの残り
+  uint16_t value;
+
+  bool inside(int x, int y) const
+  {
+    const DirtyRect &rect = snapshot.rect;
+    return y >= rect.y0 && y < rect.y1 && x >= rect.x0 && x < rect.x1;
+  }
+
+  // (x, y) から始まる同じ値の区間の長さ（limitの手前まで）と値
+  int span(int x, int y, int limit, uint16_t &spanValue)
+  {
+    const DirtyRect &rect = snapshot.rect;
+    if (y < rect.y0 || y >= rect.y1 || x >= rect.x1)
+    {
+      spanValue = 0;
+      return limit - x;
+    }
+    if (x < rect.x0)
+    {
+      spanValue = 0;
+      return min(limit, rect.x0) - x;
+    }
+    if (left == 0)
+    {
+      memcpy(&left, run, 2);
+      memcpy(&value, run + 2, 2);
+      run += RUN_BYTES;
+    }
+    spanValue = value;
+    return min((int)left, limit - x);
+  }
+
+  void advance(int x, int y, int length)
+  {
+    if (inside(x, y))
+    {
+      left -= length;
+    }
+  }
+};
+
+// RGB565の2色を混ぜる（alpha: 0〜32、値はスプライトのバッファと同じバイト順）
+// 3成分を隙間をあけて32bitの1語に広げ、1回の掛け算で3成分をまとめて混ぜる。
+static inline uint16_t blend565(uint16_t from, uint16_t to, uint32_t alpha)
+{
+  uint32_t a = __builtin_bswap16(from);
+  uint32_t b = __builtin_bswap16(to);
+  a = (a | a << 16) & RGB565_SPREAD;
+  b = (b | b << 16) & RGB565_SPREAD;
+  uint32_t mixed = ((((b - a) * alpha) >> 5) + a) & RGB565_SPREAD;
+  return __builtin_bswap16((uint16_t)(mixed | mixed >> 16));
+}
+
+// 2つのフレームで値が違う区間を、切り替え方に応じて混ぜて書く
+static void blendSpan(uint16_t *row, int x, int y, int length, uint16_t from, uint16_t to,
+                      TransitionStyle style, int progress)
+{
+  switch (style)
+  {
+  case TRANSITION_CROSSFADE:
+  {
+    uint16_t mixed = blend565(from, to, progress >> 3);
+    for (int i = 0; i < length; i++)
+    {
+      row[x + i] = mixed;
+    }
+    break;
+  }
+  case TRANSITION_WIPE:
+  {
+    // 境目から左へTRANSITION_WIPE_EDGEピクセルかけて切り替え先に変わる
+    int edge = progress * wipeWidth / TRANSITION_ONE;
+    for (int i = x; i < x + length; i++)
+    {
+      int alpha = constrain((edge - i) * TRANSITION_ONE / TRANSITION_WIPE_EDGE, 0, TRANSITION_ONE);
+      row[i] = blend565(from, to, alpha >> 3);
+    }
+    break;
+  }
+  case TRANSITION_DISSOLVE:
+  {
+    const uint8_t *order = DISSOLVE_ORDER[y & 3];
+    for (int i = x; i < x + length; i++)
+    {
+      row[i] = order[i & 3] * 16 + 8 < progress ? to : from;
+    }
+    break;
+  }
+  }
+}
+
+void transitionBlend(int group, int slot, RenderTarget &target, TransitionStyle style, int progress)
+{
+  const Snapshot &fromFrame = groups[group].fromFrames[slot];
+  const Snapshot &toFrame = groups[group].toFrames[slot];
+  DirtyRect area = fromFrame.rect;
+  area.merge(toFrame.rect);
+  target.drawn = area;
+  if (area.empty())
+  {
+    return;
+  }
+
+  int stride = target.width();
+  uint16_t *pixels = static_cast<uint16_t *>(target.sprite->getBuffer());
+  SnapshotCursor from = {fromFrame, arena + fromFrame.offset, 0, 0};
+  SnapshotCursor to = {toFrame, arena + toFrame.offset, 0, 0};
+  for (int y = area.y0; y < area.y1; y++)
+  {
+    // 行の先頭を描画の座標のXで引けるようにずらしておく
+    uint16_t *row = pixels + (y - target.originY) * stride - target.originX;
+    int x = area.x0;
+    while (x < area.x1)
+    {
+      uint16_t fromValue;
+      uint16_t toValue;
+      int length = min(from.span(x, y, area.x1, fromValue), to.span(x, y, area.x1, toValue));
+      // 同じ値の区間は切り替え先のフレームのままで正しいので触らない
+      if (fromValue != toValue)
+      {
+        blendSpan(row, x, y, length, fromValue, toValue, style, progress);
+        overdrawCountWrite(x + target.regionX, y + target.regionY, length, 1);
+      }
+      from.advance(x, y, length);
+      to.advance(x, y, length);
+      x += length;
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# 入力トレースのダンプ・読み込み・再生を行うホスト側ツール
+#
+#   python3 tools/eyes_trace.py dump   /dev/ttyACM0 trace.bin  # 実機のトレースを保存
+#   python3 tools/eyes_trace.py show   trace.bin               # トレースの内容を表示
+#   python3 tools/eyes_trace.py replay /dev/ttyACM0 trace.bin  # 実機に読み込ませて再生
+#
+# 形式は include/input_trace.h の TraceHeader / TraceRecord を参照。
+import struct
+import sys
+import time
+
+import serial  # pyserial
+
+HEADER = struct.Struct("<IHHIIII")  # magic, version, recordSize, seed, startTime, count, dropped
+RECORD = struct.Struct("<IBBH")     # time, type, arg, value
+TRACE_MAGIC = 0x52545945
+EVENT_NAMES = {1: "touch", 2: "mode"}
+
+
+def read_exact(port, size):
+    data = b""
+    while len(data) < size:
+        chunk = port.read(size - len(data))
+        if not chunk:
+            raise RuntimeError("timeout while reading trace")
+        data += chunk
+    return data
+
+
+def dump(device, path):
+    with serial.Serial(device, 115200, timeout=2) as port:
+        port.reset_input_buffer()
+        port.write(b"d")
+        header = read_exact(port, HEADER.size)
+        magic, _, record_size, _, _, count, _ = HEADER.unpack(header)
+        if magic != TRACE_MAGIC:
+            raise RuntimeError("unexpected trace magic")
+        body = read_exact(port, record_size * count)
+    with open(path, "wb") as f:
+        f.write(header + body)
+    print(f"{count} records written to {path}")
+
+
+def show(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, version, record_size, seed, start, count, dropped = HEADER.unpack_from(data)
+    if magic != TRACE_MAGIC:
+        raise RuntimeError("unexpected trace magic")
+    print(f"version {version} seed 0x{seed:08x} start {start} ms, {count} records, {dropped} dropped")
+    for i in range(count):
+        t, kind, arg, value = RECORD.unpack_from(data, HEADER.size + i * record_size)
+        print(f"{t - start:>10} ms  {EVENT_NAMES.get(kind, kind):<6} {arg} {value}")
+
+
+def replay(device, path):
+    with open(path, "rb") as f:
+        data = f.read()
+    with serial.Serial(device, 115200, timeout=1) as port:
+        port.reset_input_buffer()
+        port.write(b"l" + data)
+        print(port.readline().decode(errors="replace").strip())
+        port.write(b"p")
+        # 再生結果の統計行を表示する
+        deadline = time.time() + 120
+        while time.time() < deadline:
+            line = port.readline().decode(errors="replace").strip()
+            if line:
+                print(line)
+            if line.startswith("replay: >=64 ms"):  # 分布の最終行
+                break
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        print("usage: eyes_trace.py dump|show|replay ...")
+        sys.exit(1)
+    command = sys.argv[1]
+    if command == "dump":
+        dump(sys.argv[2], sys.argv[3])
+    elif command == "show":
+        show(sys.argv[2])
+    elif command == "replay":
+        replay(sys.argv[2], sys.argv[3])
+    else:
+        sys.exit(f"unknown command: {command}")
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# 実機の描画量（オーバードロー）を計測して、統計とヒートマップを保存する
+#
+#   python3 tools/overdraw_capture.py /dev/ttyACM0 [秒数] [出力先ディレクトリ]
+#
+# 計測開始コマンド(o)を送り、指定した秒数のあとにもう一度送って結果を受け取る。
+# 統計は標準出力に表示し、ヒートマップはマスを拡大したPGM（P5）で保存する。
+# 形式は include/overdraw_profiler.h を参照。
+import os
+import sys
+import time
+
+import serial  # pyserial
+
+PREFIX = "overdraw: "
+SCALE = 16  # 保存時の拡大率（マス1つを元のピクセルの大きさに戻す）
+
+
+def read_line(port):
+    line = port.readline()
+    if not line:
+        raise TimeoutError
+    return line.decode(errors="replace").rstrip("\r\n")
+
+
+def read_pgm(port):
+    # P2のヘッダ（コメント行を含む）と、行ごとの値を読む
+    header = []
+    while len(header) < 3:
+        line = read_line(port)
+        if not line.startswith("#"):
+            header.append(line)
+    width, height = (int(value) for value in header[1].split())
+    rows = [[int(value) for value in read_line(port).split()] for _ in range(height)]
+    return width, height, rows
+
+
+def save_pgm(path, width, height, rows):
+    with open(path, "wb") as file:
+        file.write(f"P5 {width * SCALE} {height * SCALE} 255\n".encode())
+        for row in rows:
+            line = bytes(value for value in row for _ in range(SCALE))
+            file.write(line * SCALE)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: overdraw_capture.py <serial device> [seconds] [output dir]")
+    seconds = float(sys.argv[2]) if len(sys.argv) > 2 else 30
+    out_dir = sys.argv[3] if len(sys.argv) > 3 else "overdraw"
+    os.makedirs(out_dir, exist_ok=True)
+
+    port = serial.Serial(sys.argv[1], 115200, timeout=5)
+    port.reset_input_buffer()
+    port.write(b"o")
+    time.sleep(seconds)
+    port.reset_input_buffer()
+    port.write(b"o")
+
+    while True:
+        line = read_line(port)
+        if not line.startswith(PREFIX):
+            continue
+        body = line[len(PREFIX):]
+        if body == "end":
+            break
+        if body.startswith("image "):
+            name = body.split()[1]
+            width, height, rows = read_pgm(port)
+            save_pgm(os.path.join(out_dir, name), width, height, rows)
+        else:
+            print(body)
+    port.close()
+
+
+if __name__ == "__main__":
+    main()
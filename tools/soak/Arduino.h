@@ -0,0 +1,14 @@
+// ホストでsrc/eye_state.cppをビルドするための最小限のArduino.h
+// 耐久試験（soak.cpp）が使う分だけを用意する。乱数はsoak.cppで実装する。
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using std::max;
+using std::min;
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
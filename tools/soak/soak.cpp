@@ -0,0 +1,560 @@
+// 状態機械の長期耐久試験（ホストで実行する）
+// src/eye_set.cpp・src/eye_state.cpp（モード・瞬き・視線の移動・表情・ウィンカー）を仮想クロックで動かし、
+// ランダムなタッチ入力で数か月分の運用を数十秒で再現する。
+// 目のセットはいくつでも並べられ、時計を共有しつつセットごとに別のタッチ入力で独立に動かす。
+// 時計はmillis()と同じ32bitで、開始時刻を一周の少し前にして、約49.7日ごとの一周を必ずまたがせる。
+//
+//   g++ -std=gnu++17 -O2 -Itools/soak -Iinclude tools/soak/soak.cpp src/eye_set.cpp src/eye_state.cpp -o soak
+//   ./soak [日数] [乱数シード] [目のセットの数]
+//
+// 出力（1つでも外れがあれば終了コードは1）
+//   soak: 再現した期間と速さ、時計が一周した回数
+//   soak: 起きたイベントの数（すべてのセットの瞬き・視線の移動・表情・モードの切り替え・タッチ（うち続けて叩いた数）と、ウィンカー）
+//   soak: 目のセットごとの1ステップの処理時間の日ごとの平均（最初の日・最後の日・最大）と、最初の日からの変化
+//   soak: ヒープの使用量（開始時・終了時・最大）
+//   soak: 検査ごとの外れの数（うち時計の一周の前後1分以内）
+#include <Arduino.h>
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <vector>
+#include "eye_set.h"
+
+constexpr int MAX_EYE_MOVE = 15;                      // 視線を動かす範囲（320x240のプロファイルと同じ）
+constexpr uint32_t START_BEFORE_WRAP = 10 * 60 * 1000; // 開始時刻を時計の一周の何ミリ秒前にするか
+constexpr uint32_t NEAR_WRAP = 60 * 1000;              // 一周の前後とみなす範囲（ミリ秒）
+constexpr int STEP_MIN = 17;                           // 1ステップの最短（delay(16)＋処理時間）
+constexpr int STEP_MAX = 33;                           // 1ステップの最長（描画が重いフレーム）
+constexpr uint32_t SLACK = STEP_MAX + 1;               // 期限の判定がステップの間隔だけ遅れる分
+constexpr uint64_t DAY = 24ull * 60 * 60 * 1000;       // 1日（ミリ秒）
+constexpr int COST_SAMPLE = 64;                        // 処理時間を計るステップの間隔
+constexpr int TOUCH_CHANNEL = 2;                       // 目のモードを切り替えるタッチの番号（タッチ3）
+constexpr int TOUCH_COUNT = 4;                         // タッチの数
+constexpr int DOUBLE_TAP_WINDOW = 400;                 // 続けて叩いてモードを切り替える間隔の上限（実機のMODE_TRANSITION_DURATION）
+constexpr int DOUBLE_TAP_GAP_MAX = 200;                // 続けて叩くときに離してから次に押すまでの最長
+constexpr int DOUBLE_TAP_LENGTH_MAX = 150;             // 続けて叩くときに押している時間の最長
+
+static_assert(DOUBLE_TAP_GAP_MAX + DOUBLE_TAP_LENGTH_MAX < DOUBLE_TAP_WINDOW, "double taps must switch modes within the transition");
+
+// 乱数（Arduinoのrandom()の代わり、xorshift64）
+static uint64_t randomState = 1;
+
+void randomSeed(unsigned long seed)
+{
+  randomState = seed * 0x9E3779B97F4A7C15ull + 1;
+}
+
+long random(long howbig)
+{
+  if (howbig <= 0)
+  {
+    return 0;
+  }
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return (long)(randomState % (uint64_t)howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+// 検査の種類
+enum CheckKind
+{
+  CHECK_BLINK_GAP,          // 瞬きの間隔が予定と違う
+  CHECK_BLINK_MISSING,      // 瞬きが予定の時間を過ぎても起きない
+  CHECK_BLINK_LENGTH,       // 瞬きの長さが予定と違う
+  CHECK_MOVE_GAP,           // 視線の移動の間隔が予定と違う
+  CHECK_MOVE_MISSING,       // 視線の移動が予定の時間を過ぎても起きない
+  CHECK_MOVE_LENGTH,        // 視線の移動の長さが予定と違う
+  CHECK_EXPRESSION_GAP,     // 表情の切り替えの間隔が範囲の外
+  CHECK_EXPRESSION_MISSING, // 表情の切り替えが最長の間隔を過ぎても起きない
+  CHECK_EXPRESSION_CHANGED, // 自動で切り替えないのに表情が変わった
+  CHECK_MODE_STUCK,         // スロットマシン・おやすみモードが時間切れで戻らない
+  CHECK_SUBSTATE_STUCK,     // スロットマシン・おやすみモードの中の状態が進まない
+  CHECK_WINKER_GAP,         // ウィンカーの点滅の間隔が予定と違う
+  CHECK_WINKER_STUCK,       // ウィンカーが点滅しない・離しても消えない
+  CHECK_POSITION,           // 目の位置が動かす範囲の外
+  CHECK_BRIGHTNESS,         // 通常の目なのに画面が暗い
+  CHECK_TAP_IGNORED,        // タッチ3を離してもモードが切り替わらない
+  CHECK_COUNT
+};
+
+const char *const CHECK_NAMES[CHECK_COUNT] = {
+    "blink-gap", "blink-missing", "blink-length",
+    "move-gap", "move-missing", "move-length",
+    "expression-gap", "expression-missing", "expression-changed",
+    "mode-stuck", "substate-stuck",
+    "winker-gap", "winker-stuck",
+    "position", "brightness", "tap-ignored"};
+
+// 検査の結果
+struct CheckResult
+{
+  uint64_t count;    // 外れの数
+  uint64_t nearWrap; // うち時計の一周の前後で起きた数
+  uint64_t first;    // 最初に起きた仮想時刻（開始からのミリ秒）
+};
+
+// 通常の目の間に起きる周期的なイベント（瞬き・視線の移動・表情）の追跡
+struct EventTracker
+{
+  bool seen;     // 通常の目に戻ってから1回以上起きたか
+  uint32_t last; // 最後に起きた時刻（まだなら通常の目に戻った時刻）
+  bool missing;  // 起きないことを報告済みか
+};
+
+// 目のセット1つ分の入力・追跡・集計
+struct SoakSet
+{
+  EyeSet set;                   // 目のセット
+  uint64_t nextTap;             // 次にタッチ3を叩く時刻（開始からのミリ秒）
+  uint64_t tapEnd;              // タッチ3を離す時刻
+  bool doubleTap;               // 次のタップは前のタップに続けて叩くか
+  bool wasTapping;              // 前のステップでタッチ3を押していたか
+  int lastSequence;             // 前のステップのモード切り替えのシーケンス
+  EventTracker blinks;          // 瞬き
+  EventTracker moves;           // 視線の移動
+  EventTracker expressions;     // 表情の切り替え
+  bool wasBlinking;             // 前のステップで瞬き中だったか
+  bool wasMoving;               // 前のステップで移動中だったか
+  uint32_t lastExpressionStart; // 前のステップの表情の切り替え開始時間
+  EyeMode lastMode;             // 前のステップのモード
+  uint32_t modeEntered;         // 今のモードに入った時刻
+  bool modeStuck;               // モードが戻らないことを報告済みか
+  int lastSubstate;             // 前のステップのモードの中の状態（-1: 通常の目）
+  uint32_t substateEntered;     // 今の中の状態に入った時刻
+  bool substateStuck;           // 中の状態が進まないことを報告済みか
+  uint64_t blinkCount;          // 瞬きの数
+  uint64_t moveCount;           // 視線の移動の数
+  uint64_t expressionCount;     // 表情の切り替えの数
+  uint64_t modeChanges;         // モードの切り替えの数
+  uint64_t taps;                // タッチ3を叩いた数
+  uint64_t doubleTaps;          // 続けて叩いた数
+  std::vector<double> dayCosts; // 日ごとの1ステップの平均処理時間（ナノ秒）
+  uint64_t costNanos;           // 今日の処理時間の合計（ナノ秒）
+  uint64_t costSamples;         // 今日の処理時間を計ったステップ数
+};
+
+static CheckResult results[CHECK_COUNT];
+static uint64_t elapsed = 0; // 開始からの仮想時間（ミリ秒、一周しない）
+static uint32_t now = 0;     // millis()に相当する時刻（32bit）
+
+// 目のセットの時刻の取得元（すべてのセットで共有する仮想クロック）
+static uint32_t virtualClock()
+{
+  return now;
+}
+
+static void flag(CheckKind kind)
+{
+  CheckResult &result = results[kind];
+  if (result.count == 0)
+  {
+    result.first = elapsed;
+  }
+  result.count++;
+  if (now < NEAR_WRAP || now > UINT32_MAX - NEAR_WRAP)
+  {
+    result.nearWrap++;
+  }
+}
+
+// イベントが起きたときに、前回からの間隔を[minGap, maxGap]と比べる
+static void trackEvent(EventTracker &tracker, uint32_t minGap, uint32_t maxGap, CheckKind gapCheck)
+{
+  uint32_t gap = now - tracker.last;
+  if (tracker.seen && (gap < minGap || gap > maxGap))
+  {
+    flag(gapCheck);
+  }
+  tracker = {true, now, false};
+}
+
+// イベントが最長の間隔を過ぎても起きていなければ1回だけ報告する
+static void checkMissing(EventTracker &tracker, uint32_t maxGap, CheckKind missingCheck)
+{
+  if (!tracker.missing && now - tracker.last > maxGap)
+  {
+    flag(missingCheck);
+    tracker.missing = true;
+  }
+}
+
+// 使用中のヒープ（バイト）
+static size_t heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+// 目のセットを検査する（状態を進めた直後に毎ステップ呼ぶ、tapping: このステップでタッチ3を押しているか）
+static void checkSet(SoakSet &soak, bool tapping)
+{
+  const EyeState &state = soak.set.state;
+
+  // タッチ3を離したら、続けて叩いたときもモードが切り替わる
+  if (soak.wasTapping && !tapping && state.modeSequence == soak.lastSequence)
+  {
+    flag(CHECK_TAP_IGNORED);
+  }
+  soak.wasTapping = tapping;
+  soak.lastSequence = state.modeSequence;
+
+  // モードの切り替え
+  if (state.mode != soak.lastMode)
+  {
+    soak.lastMode = state.mode;
+    soak.modeEntered = now;
+    soak.modeStuck = false;
+    soak.modeChanges++;
+    if (state.mode == NORMAL_EYE)
+    {
+      // 通常の目に戻ったら周期的なイベントの追跡をやり直す
+      // （ほかのモードで止まっていた瞬きや移動の続きは、新しいイベントとして数えない）
+      soak.blinks = {false, now, false};
+      soak.moves = {false, now, false};
+      soak.expressions = {false, now, false};
+      soak.wasBlinking = state.isBlinking;
+      soak.wasMoving = state.isMoving;
+    }
+  }
+
+  if (state.mode == NORMAL_EYE)
+  {
+    // 瞬き（予定どおりなら開始からBLINK_DURATION + BLINK_INTERVALごと）
+    if (state.isBlinking && !soak.wasBlinking)
+    {
+      trackEvent(soak.blinks, BLINK_DURATION + BLINK_INTERVAL, BLINK_DURATION + BLINK_INTERVAL + SLACK, CHECK_BLINK_GAP);
+      soak.blinkCount++;
+    }
+    if (!state.isBlinking && soak.wasBlinking && soak.blinks.seen && state.blinkStartTime == soak.blinks.last)
+    {
+      uint32_t length = now - state.blinkStartTime;
+      if (length < BLINK_DURATION || length > BLINK_DURATION + SLACK)
+      {
+        flag(CHECK_BLINK_LENGTH);
+      }
+    }
+    checkMissing(soak.blinks, BLINK_DURATION + BLINK_INTERVAL + SLACK, CHECK_BLINK_MISSING);
+
+    // 視線の移動（予定どおりなら開始からMOVE_DURATION + MOVE_PAUSEごと、最初だけ起動時の間隔）
+    if (state.isMoving && !soak.wasMoving)
+    {
+      trackEvent(soak.moves, MOVE_DURATION + MOVE_PAUSE, MOVE_DURATION + MOVE_PAUSE + SLACK, CHECK_MOVE_GAP);
+      soak.moveCount++;
+    }
+    if (!state.isMoving && soak.wasMoving && soak.moves.seen && state.moveStartTime == soak.moves.last)
+    {
+      uint32_t length = now - state.moveStartTime;
+      if (length < MOVE_DURATION || length > MOVE_DURATION + SLACK)
+      {
+        flag(CHECK_MOVE_LENGTH);
+      }
+    }
+    checkMissing(soak.moves, max(MOVE_DURATION + MOVE_PAUSE, MOVE_INTERVAL_MAX) + SLACK, CHECK_MOVE_MISSING);
+
+    // 表情の切り替え（自動で切り替えるならEXPRESSION_INTERVAL_MIN〜MAXごと、そうでなければ開いた目のまま）
+    if (state.expressionStartTime != soak.lastExpressionStart)
+    {
+      trackEvent(soak.expressions, EXPRESSION_INTERVAL_MIN, EXPRESSION_INTERVAL_MAX + SLACK, CHECK_EXPRESSION_GAP);
+      soak.expressionCount++;
+    }
+    if (EXPRESSION_AUTO_CYCLE)
+    {
+      checkMissing(soak.expressions, EXPRESSION_INTERVAL_MAX + SLACK, CHECK_EXPRESSION_MISSING);
+    }
+    else if (state.expression != EXPRESSION_OPEN)
+    {
+      flag(CHECK_EXPRESSION_CHANGED);
+    }
+
+    int limit = toSubpixel(MAX_EYE_MOVE);
+    if (abs(state.leftEye.x) > limit || abs(state.leftEye.y) > limit ||
+        abs(state.rightEye.x) > limit || abs(state.rightEye.y) > limit)
+    {
+      flag(CHECK_POSITION);
+    }
+    if (state.brightness != DISPLAY_BRIGHTNESS)
+    {
+      flag(CHECK_BRIGHTNESS);
+    }
+    soak.lastSubstate = -1;
+  }
+  else
+  {
+    // スロットマシン・おやすみモードは時間切れで戻る
+    uint32_t modeLimit = (state.mode == SLOT_MACHINE ? SLOT_MACHINE_DURATION : SLEEP_MODE_DURATION) + SLACK;
+    if (!soak.modeStuck && now - soak.modeEntered > modeLimit)
+    {
+      flag(CHECK_MODE_STUCK);
+      soak.modeStuck = true;
+    }
+
+    // 中の状態ごとの長さ（終わりの状態はモードの時間切れまで続く）
+    int substate = state.mode == SLOT_MACHINE ? state.slotState : 16 + state.sleepState;
+    if (substate != soak.lastSubstate)
+    {
+      soak.lastSubstate = substate;
+      soak.substateEntered = now;
+      soak.substateStuck = false;
+    }
+    uint32_t substateLimit = UINT32_MAX;
+    switch (substate)
+    {
+    case SLOT_START:
+      substateLimit = SLOT_SCROLL_DURATION + SLACK;
+      break;
+    case SLOT_SPINNING:
+      substateLimit = SLOT_SPIN_DURATION + SLACK;
+      break;
+    case SLOT_RESULT:
+      substateLimit = SLOT_RESULT_DURATION + SLACK;
+      break;
+    case 16 + SLEEP_START:
+      substateLimit = SLACK;
+      break;
+    case 16 + SLEEP_NORMAL:
+      substateLimit = SLEEP_NORMAL_DURATION + SLACK;
+      break;
+    case 16 + SLEEP_CLOSING:
+      substateLimit = SLEEP_CLOSING_DURATION + SLACK;
+      break;
+    case 16 + SLEEP_DIMMING:
+      substateLimit = SLEEP_DIMMING_DURATION + SLACK;
+      break;
+    default:
+      break;
+    }
+    if (!soak.substateStuck && now - soak.substateEntered > substateLimit)
+    {
+      flag(CHECK_SUBSTATE_STUCK);
+      soak.substateStuck = true;
+    }
+  }
+  soak.wasBlinking = state.mode == NORMAL_EYE && state.isBlinking;
+  soak.wasMoving = state.mode == NORMAL_EYE && state.isMoving;
+  soak.lastExpressionStart = state.expressionStartTime;
+}
+
+int main(int argc, char **argv)
+{
+  double days = argc > 1 ? atof(argv[1]) : 120;
+  unsigned long seed = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1;
+  int setCount = argc > 3 ? max(atoi(argv[3]), 1) : 1;
+  uint64_t duration = (uint64_t)(days * DAY);
+  randomSeed(seed);
+
+  // 目のセット（入力はセットごとに別の予定で叩く、タッチ3は短く叩く）
+  std::vector<SoakSet> sets(setCount);
+  now = UINT32_MAX - START_BEFORE_WRAP + 1;
+  for (SoakSet &soak : sets)
+  {
+    eyeSetBegin(soak.set, virtualClock, TOUCH_CHANNEL, MAX_EYE_MOVE);
+    soak.nextTap = random(3000, 300000);
+    soak.blinks = {false, now, false};
+    soak.moves = {false, now, false};
+    soak.expressions = {false, now, false};
+    soak.lastExpressionStart = soak.set.state.expressionStartTime;
+    soak.lastMode = soak.set.state.mode;
+    soak.modeEntered = now;
+    soak.lastSubstate = -1;
+    soak.substateEntered = now;
+    soak.dayCosts.reserve((size_t)days + 1);
+  }
+
+  // ウィンカーはすべてのセットで共有（タッチ1はしばらく押し続ける）
+  WinkerState winker = {};
+  uint64_t nextHold = random(5000, 300000);
+  uint64_t holdEnd = 0;
+  bool wasHeld = false;
+  bool winkerWasOn = false;
+  uint32_t winkerLast = now;
+  bool winkerStuck = false;
+
+  uint64_t steps = 0;
+  uint64_t toggles = 0;
+  int wraps = 0;
+
+  uint64_t nextDay = DAY;
+  size_t heapStart = heapInUse();
+  size_t heapMax = heapStart;
+  auto wallStart = std::chrono::steady_clock::now();
+
+  while (elapsed < duration)
+  {
+    // 時計を進める（32bitの時刻は一周する）
+    uint32_t step = random(STEP_MIN, STEP_MAX + 1);
+    uint32_t previous = now;
+    elapsed += step;
+    now += step;
+    if (now < previous)
+    {
+      wraps++;
+    }
+
+    // 入力を決める
+    for (SoakSet &soak : sets)
+    {
+      if (elapsed >= soak.nextTap)
+      {
+        // 4回に1回は続けてもう一度短く叩き、実機のトランジションが終わる前にモードをまた切り替える
+        soak.tapEnd = elapsed + (soak.doubleTap ? random(80, DOUBLE_TAP_LENGTH_MAX) : random(80, 500));
+        soak.taps++;
+        if (!soak.doubleTap && random(4) == 0)
+        {
+          soak.doubleTap = true;
+          soak.nextTap = soak.tapEnd + random(60, DOUBLE_TAP_GAP_MAX);
+          soak.doubleTaps++;
+        }
+        else
+        {
+          soak.doubleTap = false;
+          soak.nextTap = soak.tapEnd + random(3000, 300000);
+        }
+      }
+    }
+    if (elapsed >= nextHold)
+    {
+      holdEnd = elapsed + random(200, 10000);
+      nextHold = holdEnd + random(5000, 300000);
+    }
+    bool touch1 = elapsed < holdEnd;
+
+    // 実機のloop()と同じ順に状態機械を進める（updateEyeSets → updateWinkers）
+    // 処理時間はセットごとに、そのセットの更新とタッチの処理を合わせて計る
+    bool sample = steps % COST_SAMPLE == 0;
+    for (SoakSet &soak : sets)
+    {
+      auto costStart = sample ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+      eyeSetUpdate(soak.set);
+      if (sample)
+      {
+        soak.costNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - costStart).count();
+      }
+    }
+    winkerUpdate(winker, touch1, now);
+    for (SoakSet &soak : sets)
+    {
+      bool touches[TOUCH_COUNT] = {touch1, false, elapsed < soak.tapEnd, false};
+      auto costStart = sample ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+      eyeSetTouch(soak.set, touches);
+      if (sample)
+      {
+        soak.costNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - costStart).count();
+        soak.costSamples++;
+      }
+    }
+    steps++;
+
+    for (SoakSet &soak : sets)
+    {
+      checkSet(soak, elapsed < soak.tapEnd);
+    }
+
+    // ウィンカー（押している間はWINKER_BLINK_INTERVALごとに切り替え、離したらすぐ消える）
+    if (touch1 && !wasHeld)
+    {
+      winkerStuck = false;
+    }
+    if (winker.on != winkerWasOn)
+    {
+      toggles++;
+      uint32_t gap = now - winkerLast;
+      if (touch1 && wasHeld && (gap < WINKER_BLINK_INTERVAL || gap > WINKER_BLINK_INTERVAL + SLACK))
+      {
+        flag(CHECK_WINKER_GAP);
+      }
+      winkerLast = now;
+    }
+    if (touch1 && !winkerStuck && now - winkerLast > WINKER_BLINK_INTERVAL + SLACK)
+    {
+      flag(CHECK_WINKER_STUCK);
+      winkerStuck = true;
+    }
+    if (!touch1 && winker.on)
+    {
+      flag(CHECK_WINKER_STUCK);
+    }
+    wasHeld = touch1;
+    winkerWasOn = winker.on;
+
+    // 日ごとの集計
+    if (elapsed >= nextDay)
+    {
+      for (SoakSet &soak : sets)
+      {
+        soak.dayCosts.push_back(soak.costSamples ? (double)soak.costNanos / soak.costSamples : 0);
+        soak.costNanos = 0;
+        soak.costSamples = 0;
+      }
+      nextDay += DAY;
+      heapMax = max(heapMax, heapInUse());
+    }
+  }
+
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  size_t heapEnd = heapInUse();
+  uint64_t blinkCount = 0;
+  uint64_t moveCount = 0;
+  uint64_t expressionCount = 0;
+  uint64_t modeChanges = 0;
+  uint64_t taps = 0;
+  uint64_t doubleTaps = 0;
+  for (const SoakSet &soak : sets)
+  {
+    blinkCount += soak.blinkCount;
+    moveCount += soak.moveCount;
+    expressionCount += soak.expressionCount;
+    modeChanges += soak.modeChanges;
+    taps += soak.taps;
+    doubleTaps += soak.doubleTaps;
+  }
+  printf("soak: simulated %.1f days (%llu steps) of %d eye sets in %.1f s (%.0fx real time), clock wrapped %d times, seed %lu\n",
+         elapsed / (double)DAY, (unsigned long long)steps, setCount, wallSeconds, elapsed / 1000.0 / wallSeconds, wraps, seed);
+  printf("soak: events blinks %llu, moves %llu, expressions %llu, mode changes %llu, taps %llu (double %llu), winker toggles %llu\n",
+         (unsigned long long)blinkCount, (unsigned long long)moveCount, (unsigned long long)expressionCount,
+         (unsigned long long)modeChanges, (unsigned long long)taps, (unsigned long long)doubleTaps, (unsigned long long)toggles);
+  for (int i = 0; i < setCount; i++)
+  {
+    const std::vector<double> &dayCosts = sets[i].dayCosts;
+    if (dayCosts.empty())
+    {
+      continue;
+    }
+    size_t worst = 0;
+    for (size_t day = 1; day < dayCosts.size(); day++)
+    {
+      if (dayCosts[day] > dayCosts[worst])
+      {
+        worst = day;
+      }
+    }
+    printf("soak: set %d step cost first day %.1f ns, last day %.1f ns, max %.1f ns (day %zu), drift %+.1f%%\n", i,
+           dayCosts.front(), dayCosts.back(), dayCosts[worst], worst + 1,
+           dayCosts.front() > 0 ? (dayCosts.back() / dayCosts.front() - 1) * 100 : 0.0);
+  }
+  printf("soak: heap in use start %zu bytes, end %zu bytes, max %zu bytes\n", heapStart, heapEnd, heapMax);
+
+  bool failed = false;
+  for (int i = 0; i < CHECK_COUNT; i++)
+  {
+    const CheckResult &result = results[i];
+    printf("soak: check %-18s %llu (near wrap %llu)", CHECK_NAMES[i], (unsigned long long)result.count,
+           (unsigned long long)result.nearWrap);
+    if (result.count > 0)
+    {
+      printf(", first at day %.3f", result.first / (double)DAY);
+      failed = true;
+    }
+    printf("\n");
+  }
+  printf("soak: %s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
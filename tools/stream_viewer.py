@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+# 実機のライブストリームを表示するホスト側ビューア
+#
+#   python3 tools/stream_viewer.py /dev/ttyACM0 [倍率]
+#
+# 接続するとストリーム開始コマンド(v)を送り、ウィンドウを閉じると停止コマンドを送る。
+# 形式は include/frame_stream.h を参照。
+import struct
+import sys
+import threading
+import tkinter as tk
+
+import serial  # pyserial
+
+SYNC = b"\xe5\x5e"
+FLAG_KEYFRAME = 0x01
+FRAME_HEADER = struct.Struct("<BBHHH")  # flags, rectCount, frameIndex, width, height
+RECT_HEADER = struct.Struct("<HHHH")    # x, y, w, h
+
+
+class StreamDecoder:
+    def __init__(self):
+        self.width = 0
+        self.height = 0
+        self.stride = 0
+        self.bits = bytearray()
+        self.frames = 0
+
+    def read_exact(self, port, size):
+        data = b""
+        while len(data) < size:
+            chunk = port.read(size - len(data))
+            if not chunk:
+                raise TimeoutError
+            data += chunk
+        return data
+
+    def sync(self, port):
+        # 同期バイトまで読み飛ばす（テキスト出力が混ざっていてもよい）
+        previous = b""
+        while True:
+            byte = self.read_exact(port, 1)
+            if previous + byte == SYNC:
+                return
+            previous = byte
+
+    def decode_frame(self, port, lock):
+        self.sync(port)
+        flags, rect_count, _, width, height = FRAME_HEADER.unpack(self.read_exact(port, FRAME_HEADER.size))
+
+        # 矩形ごとのXOR差分をすべて読み込んでから、まとめて画面に適用する
+        rects = []
+        for _ in range(rect_count):
+            x, y, w, h = RECT_HEADER.unpack(self.read_exact(port, RECT_HEADER.size))
+            remaining = (w // 8) * h
+            delta = bytearray()
+            while len(delta) < remaining:
+                count, value = self.read_exact(port, 2)
+                delta += bytes([value]) * count
+            rects.append((x, y, w // 8, h, delta))
+
+        with lock:
+            if (width, height) != (self.width, self.height) or flags & FLAG_KEYFRAME:
+                self.width, self.height = width, height
+                self.stride = (width + 7) // 8
+                self.bits = bytearray(self.stride * height)
+            for x, y, row_bytes, h, delta in rects:
+                for row in range(h):
+                    start = (y + row) * self.stride + x // 8
+                    for column in range(row_bytes):
+                        self.bits[start + column] ^= delta[row * row_bytes + column]
+            self.frames += 1
+
+    def to_ppm(self, scale):
+        # 1bppのフレームを拡大したPPM画像にする
+        rows = []
+        for y in range(self.height):
+            row = bytearray()
+            for x in range(self.width):
+                on = self.bits[y * self.stride + x // 8] & (0x80 >> (x % 8))
+                row += (b"\xff\xff\xff" if on else b"\x00\x00\x00") * scale
+            rows.append(bytes(row) * scale)
+        header = f"P6 {self.width * scale} {self.height * scale} 255 ".encode()
+        return header + b"".join(rows)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: stream_viewer.py <serial device> [scale]")
+    scale = int(sys.argv[2]) if len(sys.argv) > 2 else 2
+    port = serial.Serial(sys.argv[1], 115200, timeout=2)
+    port.reset_input_buffer()
+    port.write(b"v")
+
+    decoder = StreamDecoder()
+    lock = threading.Lock()
+    running = True
+
+    def reader():
+        while running:
+            try:
+                decoder.decode_frame(port, lock)
+            except TimeoutError:
+                continue
+
+    root = tk.Tk()
+    root.title("LCD-EYES stream")
+    label = tk.Label(root)
+    label.pack()
+
+    def refresh():
+        with lock:
+            if decoder.width:
+                image = tk.PhotoImage(data=decoder.to_ppm(scale), format="PPM")
+                label.configure(image=image)
+                label.image = image
+                root.title(f"LCD-EYES stream ({decoder.frames} frames)")
+        root.after(50, refresh)
+
+    thread = threading.Thread(target=reader, daemon=True)
+    thread.start()
+    refresh()
+    root.mainloop()
+
+    running = False
+    port.write(b"v")
+    port.close()
+
+
+if __name__ == "__main__":
+    main()